@@ -13,6 +13,7 @@ out vec4 fragColour;
 // Main function ---------------
 void main() {
     fragColour = texture(Image, texCoords);
+    if (fragColour.a == 0.0) discard;   // invisible anyways - this way the sun's occlusion queries only count its disc
     fragColour.a *= Transparency;
 }
 
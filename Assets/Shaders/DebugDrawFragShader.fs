@@ -1,7 +1,7 @@
 #version 330
 
 // Input attributes ---------------
-in vec3 worldPosition;
+in vec4 lineColour;
 
 // Output data ---------------
 out vec4 fragColour;
@@ -9,5 +9,5 @@ out vec4 fragColour;
 // Main function ---------------
 void main()
 {
-    fragColour = vec4(1, 0, 0.5, 0.5);
+    fragColour = lineColour;
 }
@@ -0,0 +1,27 @@
+#version 330
+
+// Input attributes ---------------
+layout(location = 0) in vec3 position;     // already in world space
+layout(location = 1) in vec4 colour;
+
+// Input uniforms ---------------
+layout(std140) uniform PassData {
+    mat4 View;
+    mat4 Projection;
+    vec4 CameraPosition;
+    vec4 ClippingPlane;
+    int ClippingEnabled;
+};
+
+// Output data ---------------
+out vec4 lineColour;
+
+// Main function ---------------
+void main() {
+    gl_Position = Projection * View * vec4(position, 1.0);
+    
+    lineColour = colour;
+    
+    if (ClippingEnabled != 0) gl_ClipDistance[0] = dot(vec4(position, 1), ClippingPlane);
+    else                      gl_ClipDistance[0] = 1; // don't clip
+}
@@ -1,58 +1,70 @@
 #version 330
 
+#define MAX_CASCADES 4  // see ShadowCascades.hpp
+
 // Input attributes ---------------
 in vec3 worldPosition;
 in vec3 surfaceNormal; // normalized
 in vec2 texCoords;
-in vec4 shadowMapPosition;
 
 // Input uniforms ---------------
-uniform vec3 LightColor;
-uniform vec3 LightPosition;
-uniform vec3 CameraPosition;
-uniform vec3 AmbientIntensity;
+layout(std140) uniform FrameData {
+    vec4 LightColor;
+    vec4 LightPosition;
+    vec4 AmbientIntensity;
+    mat4 ToShadowMapSpace[MAX_CASCADES];    // sun's view & projection of each cascade
+    vec4 CascadeSplits;                     // distance from the camera at which each cascade ends
+    ivec4 CascadeCount;                     // only x is used
+};
+
+layout(std140) uniform PassData {
+    mat4 View;
+    mat4 Projection;
+    vec4 CameraPosition;
+    vec4 ClippingPlane;
+    int ClippingEnabled;
+};
+
+layout(std140) uniform ObjectData {
+    mat4 Model;
+    vec4 MaterialKd;
+    vec4 MaterialKs;    // w = shininess
+    ivec4 ObjectFlags;  // x = is terrain object, y = is mesh object, z = is instanced, w = has no texture coordinates
+    vec4 DequantScale;  // maps packed vertices back to model space (see VertexFormat.hpp)
+    vec4 DequantOffset;
+};
 
-uniform bool IsTerrainObject;
 uniform sampler2D GrassTexture;
 uniform sampler2D DirtTexture;
-uniform sampler2D ShadowMap;
+uniform sampler2DArray ShadowMap;   // 1 layer per cascade
 
-uniform bool IsMeshObject;
 uniform sampler2D DiffuseTexture;
 //uniform sampler2D SpecularTexture;
 //uniform sampler2D NormalMap;
 
-struct Material {
-    vec3 ka;
-    vec3 kd;
-    vec3 ks;
-    float shininess;
-};
-uniform Material material;
-
 // Output data ---------------
 out vec4 fragColour;
 
 // Helper function ---------------
 vec4 getPhongLighting()
 {
-    vec3 l = normalize(LightPosition - worldPosition);
+    vec3 l = normalize(LightPosition.xyz - worldPosition);
     
     /* 1) Ambient lighting */
-    vec3 ambient = AmbientIntensity * LightColor;
+    vec3 ambient = AmbientIntensity.rgb * LightColor.rgb;
     
     /* 2) Diffuse lighting */
     float n_dot_l = max(dot(surfaceNormal, l), 0.0); // make sure the value is not negative
-    vec3 diffuse = material.kd * n_dot_l * LightColor;
+    vec3 diffuse = MaterialKd.rgb * n_dot_l * LightColor.rgb;
     
     /* 3) Specular lighting */
     vec3 specular = vec3(0.0);
     if (n_dot_l > 0.0) {
-        vec3 v = normalize(CameraPosition - worldPosition);
+        vec3 v = normalize(CameraPosition.xyz - worldPosition);
         vec3 h = normalize(v + l);  // halfway vector
         float n_dot_h = max(dot(surfaceNormal, h), 0.0);
         
-        specular = material.ks * pow(n_dot_h, material.shininess) * LightColor;
+        specular = MaterialKs.rgb * pow(n_dot_h, MaterialKs.w) * LightColor.rgb;
     }
     
     return vec4(ambient + diffuse + specular, 1.0);
@@ -68,7 +80,18 @@ bool isOccluded()
      we are NOT occluded (aka another object is not casting a shadow on us).
      */
     
+    // Use the first (ie. sharpest) cascade which covers our distance from the camera
+    float distToCamera = -(View * vec4(worldPosition, 1.0f)).z;
+    int cascade = 0;
+    while (cascade < CascadeCount.x - 1 && distToCamera > CascadeSplits[cascade])
+        cascade++;
+    
+    if (distToCamera > CascadeSplits[CascadeCount.x - 1])
+        // Too far away to receive shadows
+        return false;
+    
     // Convert shadow map position from NDC ( [-1, 1] ) to texture coordinates ( [0, 1] )
+    vec4 shadowMapPosition = ToShadowMapSpace[cascade] * vec4(worldPosition, 1.0f);
     vec3 coords = shadowMapPosition.xyz;
     coords = (coords + 1.0f) / 2.0f;
     
@@ -76,7 +99,7 @@ bool isOccluded()
         // This fragment is not on the shadow map
         return false;
     
-    float nearestObjectToLightSource = texture(ShadowMap, coords.xy).r;
+    float nearestObjectToLightSource = texture(ShadowMap, vec3(coords.xy, cascade)).r;
     float distToLightSource = coords.z;
     
     return distToLightSource > nearestObjectToLightSource;
@@ -85,11 +108,11 @@ bool isOccluded()
 // Main function ---------------
 void main()
 {
-    if (IsTerrainObject)
+    if (ObjectFlags.x != 0)      // terrain
     {
         vec4 lighting = getPhongLighting();
         if ( isOccluded() )
-            lighting = vec4(AmbientIntensity * LightColor, 1.0f);
+            lighting = vec4(AmbientIntensity.rgb * LightColor.rgb, 1.0f);
         
         vec4 grassColour = texture(GrassTexture, texCoords) * lighting;
         vec4 dirtColour = texture(DirtTexture, texCoords) * lighting;
@@ -106,7 +129,7 @@ void main()
             fragColour = mix(dirtColour, grassColour, blendFactor);
         }
     }
-    else if (IsMeshObject)
+    else if (ObjectFlags.y != 0) // mesh
     {
         vec4 lighting = getPhongLighting();
         fragColour = texture(DiffuseTexture, texCoords) * lighting;
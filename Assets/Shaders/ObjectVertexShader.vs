@@ -1,35 +1,70 @@
 #version 330
 
+#define MAX_CASCADES 4  // see ShadowCascades.hpp
+
 // Input attributes ---------------
-in vec3 position;
-in vec3 normal;
-in vec2 textureCoords;
+// Note: the vertices are packed (see VertexFormat.hpp) & get unpacked in main
+layout(location = 0) in vec3 position;         // 16 bit integers spanning the object's bounds
+layout(location = 1) in vec2 normal;           // octahedral encoding, as 16 bit integers
+layout(location = 2) in vec2 textureCoords;    // normalized to [0, 1]
+layout(location = 4) in mat4 InstanceModel;    // locations 4-7, one per instance (see FishSchool)
 
 // Input uniforms ---------------
-uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
+layout(std140) uniform FrameData {
+    vec4 LightColor;
+    vec4 LightPosition;
+    vec4 AmbientIntensity;
+    mat4 ToShadowMapSpace[MAX_CASCADES];    // sun's view & projection of each cascade
+    vec4 CascadeSplits;                     // distance from the camera at which each cascade ends
+    ivec4 CascadeCount;                     // only x is used
+};
 
-uniform mat4 ToShadowMapSpace;
+layout(std140) uniform PassData {
+    mat4 View;
+    mat4 Projection;
+    vec4 CameraPosition;
+    vec4 ClippingPlane;
+    int ClippingEnabled;
+};
 
-uniform bool ClippingEnabled;
-uniform vec4 ClippingPlane;
+layout(std140) uniform ObjectData {
+    mat4 Model;
+    vec4 MaterialKd;
+    vec4 MaterialKs;    // w = shininess
+    ivec4 ObjectFlags;  // x = is terrain object, y = is mesh object, z = is instanced, w = has no texture coordinates
+    vec4 DequantScale;  // maps packed vertices back to model space (see VertexFormat.hpp)
+    vec4 DequantOffset;
+};
 
 // Output data ---------------
 out vec3 worldPosition;
 out vec3 surfaceNormal; // normalized
 out vec2 texCoords;
-out vec4 shadowMapPosition;
+
+// Helpers ---------------
+// Inverse of Quantization::packNormal: unfolds the octahedron back into a unit vector
+vec3 decodeNormal(vec2 e) {
+    e /= 32767.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 // Main function ---------------
 void main() {
-    gl_Position = Projection * View * Model * vec4(position, 1.0);
+    // Instanced draws get their model matrix from the instance buffer instead of the object block
+    mat4 model = (ObjectFlags.z != 0) ? InstanceModel : Model;
+    
+    vec3 modelPosition = position * DequantScale.xyz + DequantOffset.xyz;
+    gl_Position = Projection * View * model * vec4(modelPosition, 1.0);
+    
+    worldPosition = vec3(model * vec4(modelPosition, 1.0));
+    surfaceNormal = normalize(vec3(mat3(transpose(inverse(model))) * decodeNormal(normal)));
     
-    worldPosition = vec3(Model * vec4(position, 1.0));
-    surfaceNormal = normalize(vec3(mat3(transpose(inverse(Model))) * normal));
-    texCoords = textureCoords; // simply pass this along
-    shadowMapPosition = ToShadowMapSpace * vec4(worldPosition, 1.0f);
+    // The terrain's texture is tiled along its x & z axes, so it doesn't upload any coordinates for it
+    if (ObjectFlags.w != 0) texCoords = modelPosition.zx * DequantScale.w + DequantOffset.w;
+    else                    texCoords = textureCoords * DequantScale.w + DequantOffset.w;
     
-    if (ClippingEnabled) gl_ClipDistance[0] = dot(vec4(worldPosition, 1), ClippingPlane);
-    else                 gl_ClipDistance[0] = 1; // don't clip
+    if (ClippingEnabled != 0) gl_ClipDistance[0] = dot(vec4(worldPosition, 1), ClippingPlane);
+    else                      gl_ClipDistance[0] = 1; // don't clip
 }
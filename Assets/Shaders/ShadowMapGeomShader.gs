@@ -0,0 +1,46 @@
+#version 330
+
+// Renders every triangle into each of the shadow cascades (1 layer of the shadow map texture array
+// per cascade) so that all of them get drawn in a single pass
+
+#define MAX_CASCADES 4
+
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 12) out;    // 3 * MAX_CASCADES
+
+// Input uniforms ---------------
+layout(std140) uniform FrameData {
+    vec4 LightColor;
+    vec4 LightPosition;
+    vec4 AmbientIntensity;
+    mat4 ToShadowMapSpace[MAX_CASCADES];    // sun's view & projection of each cascade
+    vec4 CascadeSplits;
+    ivec4 CascadeCount;                     // only x is used
+};
+
+uniform int CascadeMask;    // bit i is set if cascade i should be rendered to
+
+// Main function ---------------
+void main() {
+    for (int cascade = 0; cascade < CascadeCount.x; cascade++) {
+        if ((CascadeMask & (1 << cascade)) == 0) continue;
+        
+        vec4 corners[3];
+        for (int i = 0; i < 3; i++) corners[i] = ToShadowMapSpace[cascade] * gl_in[i].gl_Position;
+        
+        // Skip triangles which are entirely to one side of the cascade (no need to check near & far,
+        // depth clamping keeps those)
+        if (all(lessThan(vec3(corners[0].x, corners[1].x, corners[2].x), vec3(-1.0))) ||
+            all(greaterThan(vec3(corners[0].x, corners[1].x, corners[2].x), vec3(1.0))) ||
+            all(lessThan(vec3(corners[0].y, corners[1].y, corners[2].y), vec3(-1.0))) ||
+            all(greaterThan(vec3(corners[0].y, corners[1].y, corners[2].y), vec3(1.0))))
+            continue;
+        
+        for (int i = 0; i < 3; i++) {
+            gl_Position = corners[i];
+            gl_Layer = cascade;
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
@@ -1,14 +1,23 @@
 #version 330
 
 // Input attributes ---------------
-in vec3 position;
+// Note: same location as in the object shader, so that meshes can share one VAO between both
+layout(location = 0) in vec3 position;         // packed, see the object shader
+layout(location = 4) in mat4 InstanceModel;    // locations 4-7, one per instance (see FishSchool)
 
 // Input uniforms ---------------
-uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
+layout(std140) uniform ObjectData {
+    mat4 Model;
+    vec4 MaterialKd;
+    vec4 MaterialKs;    // w = shininess
+    ivec4 ObjectFlags;  // x = is terrain object, y = is mesh object, z = is instanced, w = has no texture coordinates
+    vec4 DequantScale;  // maps packed vertices back to model space (see VertexFormat.hpp)
+    vec4 DequantOffset;
+};
 
 // Main function ---------------
 void main() {
-    gl_Position = Projection * View * Model * vec4(position, 1.0);
+    // The geometry shader projects the vertex into each cascade, so we only go as far as world space
+    mat4 model = (ObjectFlags.z != 0) ? InstanceModel : Model;
+    gl_Position = model * vec4(position * DequantScale.xyz + DequantOffset.xyz, 1.0);
 }
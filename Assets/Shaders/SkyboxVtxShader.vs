@@ -4,16 +4,31 @@
 in vec3 position;
 
 // Input uniforms ---------------
-uniform mat4 Model;
-uniform mat4 View;
-uniform mat4 Projection;
+layout(std140) uniform PassData {
+    mat4 View;
+    mat4 Projection;
+    vec4 CameraPosition;
+    vec4 ClippingPlane;
+    int ClippingEnabled;
+};
+
+layout(std140) uniform ObjectData {
+    mat4 Model;
+    vec4 MaterialKd;
+    vec4 MaterialKs;    // w = shininess
+    ivec4 ObjectFlags;  // x = is terrain object, y = is mesh object, z = is instanced, w = has no texture coordinates
+    vec4 DequantScale;  // maps packed vertices back to model space (see VertexFormat.hpp)
+    vec4 DequantOffset;
+};
 
 // Output data ---------------
 out vec3 texCoords;
 
 // Main function ---------------
 void main() {
-	gl_Position = Projection * View * Model * vec4(position, 1.0);
+    // Remove the translation component of the view matrix so the skybox always surrounds the camera
+    mat4 view = mat4(mat3(View));
+	gl_Position = Projection * view * Model * vec4(position, 1.0);
 
     // Sample the positions of the cube as texture coordinates
     texCoords = position;
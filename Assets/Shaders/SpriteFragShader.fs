@@ -0,0 +1,17 @@
+#version 330
+
+// Input attributes ---------------
+in vec2 atlasCoords;
+in float transparency;
+
+// Input uniforms ---------------
+uniform sampler2D Image;    // the sprite atlas
+
+// Output data ---------------
+out vec4 fragColour;
+
+// Main function ---------------
+void main() {
+    fragColour = texture(Image, atlasCoords);
+    fragColour.a *= transparency;
+}
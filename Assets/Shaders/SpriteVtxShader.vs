@@ -0,0 +1,18 @@
+#version 330
+
+// Input attributes ---------------
+layout(location = 0) in vec2 position;     // already in NDC
+layout(location = 1) in vec2 texCoords;    // in the sprite atlas
+layout(location = 2) in float alpha;
+
+// Output data ---------------
+out vec2 atlasCoords;
+out float transparency;
+
+// Main function ---------------
+void main() {
+    gl_Position = vec4(position, 0.0, 1.0);
+    
+    atlasCoords = texCoords;
+    transparency = alpha;
+}
@@ -1,14 +1,38 @@
 #version 330
 
+#define MAX_CASCADES 4  // see ShadowCascades.hpp
+
 // Input attributes ---------------
 in vec4 clipSpaceCoords;
 in vec2 textureCoords;
 in vec3 worldPosition;
 
 // Input uniforms ---------------
-uniform vec3 LightColor;
-uniform vec3 LightPosition;
-uniform vec3 CameraPosition;
+layout(std140) uniform FrameData {
+    vec4 LightColor;
+    vec4 LightPosition;
+    vec4 AmbientIntensity;
+    mat4 ToShadowMapSpace[MAX_CASCADES];    // sun's view & projection of each cascade
+    vec4 CascadeSplits;                     // distance from the camera at which each cascade ends
+    ivec4 CascadeCount;                     // only x is used
+};
+
+layout(std140) uniform PassData {
+    mat4 View;
+    mat4 Projection;
+    vec4 CameraPosition;
+    vec4 ClippingPlane;
+    int ClippingEnabled;
+};
+
+layout(std140) uniform ObjectData {
+    mat4 Model;
+    vec4 MaterialKd;
+    vec4 MaterialKs;    // w = shininess
+    ivec4 ObjectFlags;  // x = is terrain object, y = is mesh object, z = is instanced, w = has no texture coordinates
+    vec4 DequantScale;  // maps packed vertices back to model space (see VertexFormat.hpp)
+    vec4 DequantOffset;
+};
 
 uniform sampler2D ReflectionTexture;
 uniform sampler2D RefractionTexture;
@@ -28,14 +52,6 @@ uniform float Time;
 uniform float WaterDistortion;
 uniform bool BumpMapping;
 
-struct Material {
-    vec3 ka;
-    vec3 kd;
-    vec3 ks;
-    float shininess;
-};
-uniform Material material;
-
 // Output data ---------------
 out vec4 fragColour;
 
@@ -137,11 +153,11 @@ vec3 getPerturbedNormal(vec2 waveMapTexCoords)
 vec4 getSpecularHighlights(float waterDepth, vec3 surfaceNormal)
 {
     // Use classic Phong lighting to calculate specular component
-    vec3 v = normalize(CameraPosition - worldPosition);
-    vec3 l = normalize(worldPosition - LightPosition);
+    vec3 v = normalize(CameraPosition.xyz - worldPosition);
+    vec3 l = normalize(worldPosition - LightPosition.xyz);
     vec3 reflectedLight = reflect(l, surfaceNormal);
     float specImpact = max(dot(v, reflectedLight), 0.0);
-    vec3 specular = material.ks * pow(specImpact, material.shininess) * LightColor;
+    vec3 specular = MaterialKs.rgb * pow(specImpact, MaterialKs.w) * LightColor.rgb;
     
     // Just like we did for the displacement, we'll dampen the specular highlights according to water depth
     if (waterDepth < 10.0f) specular *= waterDepth / 10.0f;
@@ -156,7 +172,7 @@ float getBlendFactor(vec3 surfaceNormal)
      In order to determine how to blend our reflection & refraction samples, we'll determine the angle at which we
      are viewing the water's surface and sample more reflection when we're lower & more refraction when we're higher
      */
-    float blendFactor = dot(normalize(CameraPosition - worldPosition), surfaceNormal);
+    float blendFactor = dot(normalize(CameraPosition.xyz - worldPosition), surfaceNormal);
     blendFactor = pow(blendFactor, 0.4);        // make the water less reflective in general
     blendFactor = clamp(blendFactor, 0.0, 1.0); // clamp to a valid range
     return blendFactor;
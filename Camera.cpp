@@ -6,12 +6,17 @@ using namespace glm;
 Camera::Camera(float w, float h) : m_angleToPlayer(0), m_pitch(25.0f), m_zoom(70), m_player(nullptr),
     m_near(0.1f), m_far(11000.0f), // Note that really far clipping plane is necessary for the sun
     m_facing(0.0f), m_thirdPersonView(true)
+{
+    resize(w, h);
+};
+
+void Camera::resize(float w, float h)
 {
     m_proj = perspective(radians(45.0f),
                          w / h,   // aspect
                          m_near,
                          m_far);
-};
+}
 
 void Camera::reset()
 {
@@ -24,6 +24,7 @@ class Camera {
     
 public:
     Camera(float w, float h);
+    void resize(float w, float h);      // updates the aspect ratio
     void setCharacter(Character* p);    // must be called ASAP after construction
     
     void reset();
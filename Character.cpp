@@ -5,7 +5,9 @@
 using namespace std;
 using namespace glm;
 
-Character::Character(ShaderProgram* shader, Scene* scene) : Model(shader, scene, "Assets/Boat/boat.obj")
+const char* const Character::MODEL_PATH = "Assets/Boat/boat.obj";
+
+Character::Character(Shader* shader, Scene* scene) : Model(shader, scene, MODEL_PATH)
 {
     
 }
@@ -0,0 +1,83 @@
+#include "CookedFile.hpp"
+#include "FileSystem.hpp"
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+
+using namespace std;
+
+bool stampSource(const string& source, SourceStamp& stamp)
+{
+    return FileSystem::get().stamp(source, stamp);
+}
+
+// FNV-1a
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i=0; i<size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+string cookedPath(const string& source, const string& extension)
+{
+    string normalized = FileSystem::normalize(source);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx", (unsigned long long) hashBytes(normalized.data(), normalized.size()));
+    return string(COOKED_DIRECTORY) + "/" + name + extension;
+}
+
+bool writeCookedFile(const string& path, const vector< pair<const void*, size_t> >& parts)
+{
+    mkdir(COOKED_DIRECTORY, 0755);  // fails harmlessly if it already exists
+
+    string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Error writing %s\n", temporary.c_str());
+        return false;
+    }
+
+    bool written = true;
+    for (auto& part : parts)
+        if (part.second > 0) written = written && fwrite(part.first, part.second, 1, file) == 1;
+    written = (fclose(file) == 0) && written;
+
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Error writing %s\n", path.c_str());
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// MappedFile ----------------------------------------------------------------------------------
+
+bool MappedFile::open(const string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);    // the mapping stays valid without the file being open
+    if (mapping == MAP_FAILED) return false;
+
+    data = (const unsigned char*) mapping;
+    size = info.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data) munmap((void*) data, size);
+    data = nullptr;
+    size = 0;
+}
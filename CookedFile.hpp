@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ Helpers shared by the assets which get "cooked": converted once from their source format (PNG, OBJ)
+ into a binary file in COOKED_DIRECTORY which can be memory mapped & used as is on later launches.
+ A cooked file is named after a hash of its source's path, & remembers the source's modification
+ time & size in its header - if either changed, the asset gets cooked again.
+ */
+static const char* const COOKED_DIRECTORY = "Cache";
+
+struct SourceStamp {
+    uint64_t time;      // modification time, in seconds
+    uint64_t size;      // in bytes
+};
+
+// Returns false if the source doesn't exist (see FileSystem::stamp)
+bool stampSource(const std::string& source, SourceStamp& stamp);
+
+// Hash of size bytes - pass the hash of the previous bytes to hash several buffers as if they were one
+static const uint64_t HASH_SEED = 14695981039346656037ull;
+uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HASH_SEED);
+
+// Path of the cooked version of source, ie. Cache/0123456789abcdef.tex
+std::string cookedPath(const std::string& source, const std::string& extension);
+
+// Writes the parts one after the other into path, under another name first so that a half written
+// file can never be picked up - returns false (& prints why) if the file couldn't be written
+bool writeCookedFile(const std::string& path, const std::vector< std::pair<const void*, size_t> >& parts);
+
+// A read-only view of a whole file
+// Note: the view isn't released automatically - close() has to be called once it's no longer needed
+struct MappedFile {
+    const unsigned char* data;
+    size_t size;
+
+    MappedFile() : data(nullptr), size(0) {};
+
+    bool open(const std::string& path);
+    void close();
+};
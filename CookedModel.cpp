@@ -0,0 +1,258 @@
+#include "CookedModel.hpp"
+#include "MeshOptimizer.hpp"
+#include "FileSystem.hpp"
+#include <assimp/Importer.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+static const char MAGIC[4] = { 'C', 'M', 'D', 'L' };
+static const uint32_t VERSION = 1;  // bump whenever the layout below (or the cooking) changes
+
+// Start of every cooked file
+struct CookedModelHeader {
+    char magic[4];
+    uint32_t version;
+    SourceStamp source;
+    uint32_t meshCount;
+    uint32_t vertexCount;   // of all the meshes
+    uint32_t indexCount;
+    uint32_t namesSize;     // in bytes
+};
+
+// An entry of the mesh table
+struct CookedMeshEntry {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;    // relative to the mesh's first vertex
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    float minBounds[3];
+    float maxBounds[3];
+};
+
+// Loading -------------------------------------------------------------------------------------
+
+bool CookedModel::load(const string& source)
+{
+    SourceStamp stamp;
+    if (!stampSource(source, stamp)) return false;
+
+    MappedFile file;
+    if (!file.open(cookedPath(source, ".mdl"))) return false;
+
+    // Throw the file out if it's for a different version of the source (or of this code)
+    const CookedModelHeader* header = (const CookedModelHeader*) file.data;
+    bool valid = file.size >= sizeof(CookedModelHeader) &&
+                 memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header->version == VERSION &&
+                 header->source.time == stamp.time &&
+                 header->source.size == stamp.size &&
+                 file.size == sizeof(CookedModelHeader) + header->meshCount * sizeof(CookedMeshEntry) +
+                              header->vertexCount * sizeof(MeshVertex) + header->indexCount * sizeof(GLuint) +
+                              header->namesSize;
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    const CookedMeshEntry* entries = (const CookedMeshEntry*) (file.data + sizeof(CookedModelHeader));
+    const MeshVertex* vertices = (const MeshVertex*) (entries + header->meshCount);
+    const GLuint* indices = (const GLuint*) (vertices + header->vertexCount);
+    const char* names = (const char*) (indices + header->indexCount);
+
+    for (uint32_t i=0; i<header->meshCount; i++) {
+        const CookedMeshEntry& entry = entries[i];
+        if ((uint64_t) entry.firstVertex + entry.vertexCount > header->vertexCount ||
+            (uint64_t) entry.firstIndex + entry.indexCount > header->indexCount ||
+            (uint64_t) entry.nameOffset + entry.nameLength > header->namesSize) {
+            file.close();
+            return false;
+        }
+    }
+
+    // Every blob is copied straight into the meshes
+    meshes.resize(header->meshCount);
+    for (uint32_t i=0; i<header->meshCount; i++) {
+        const CookedMeshEntry& entry = entries[i];
+        CookedMesh& mesh = meshes[i];
+        mesh.name.assign(names + entry.nameOffset, entry.nameLength);
+        mesh.vertices.assign(vertices + entry.firstVertex, vertices + entry.firstVertex + entry.vertexCount);
+        mesh.indices.assign(indices + entry.firstIndex, indices + entry.firstIndex + entry.indexCount);
+        mesh.minBounds = vec3(entry.minBounds[0], entry.minBounds[1], entry.minBounds[2]);
+        mesh.maxBounds = vec3(entry.maxBounds[0], entry.maxBounds[1], entry.maxBounds[2]);
+    }
+
+    file.close();
+    return true;
+}
+
+// Cooking -------------------------------------------------------------------------------------
+
+// A file opened by assimp, read straight out of its FileView
+struct FileSystemStream : public Assimp::IOStream {
+    FileView view;
+    size_t position;
+
+    FileSystemStream() : position(0) {};
+    ~FileSystemStream() { view.release(); };
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0) return 0;
+        count = std::min(count, (view.size - position) / size);
+        memcpy(buffer, view.data + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void*, size_t, size_t) override { return 0; }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t base = (origin == aiOrigin_SET) ? 0 : (origin == aiOrigin_CUR) ? position : view.size;
+        if (offset > view.size - base) return aiReturn_FAILURE;
+        position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override        { return position; };
+    size_t FileSize() const override    { return view.size; };
+    void Flush() override               {};
+};
+
+// Makes assimp read the model & the files it refers to (ie. its materials) through the file system
+struct FileSystemIO : public Assimp::IOSystem {
+    bool Exists(const char* path) const override    { return FileSystem::get().exists(path); };
+    char getOsSeparator() const override            { return '/'; };
+
+    Assimp::IOStream* Open(const char* path, const char* mode) override
+    {
+        if (strchr(mode, 'w') || strchr(mode, 'a')) return nullptr;     // assets are read only
+
+        FileSystemStream* stream = new FileSystemStream();
+        if (!FileSystem::get().open(path, stream->view)) {
+            delete stream;
+            return nullptr;
+        }
+        return stream;
+    }
+
+    void Close(Assimp::IOStream* stream) override   { delete stream; };
+};
+
+// Copies the vertex & index data out of an assimp mesh
+static CookedMesh importMesh(aiMesh* mesh)
+{
+    CookedMesh cooked;
+    cooked.name = mesh->mName.C_Str();
+
+    // Note: the bounding box always contains the model's origin
+    cooked.minBounds = vec3(0.0f);
+    cooked.maxBounds = vec3(0.0f);
+
+    cooked.vertices.resize(mesh->mNumVertices);
+    for (unsigned i=0; i < mesh->mNumVertices; i++)
+    {
+        MeshVertex vtx;
+        vtx.position      = vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        vtx.normal        = vec3(mesh->mNormals[i].x,  mesh->mNormals[i].y,  mesh->mNormals[i].z);
+        if (mesh->mTextureCoords[0])
+            vtx.texCoords = vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+        else
+            vtx.texCoords = vec2(0.0f);
+
+        cooked.vertices[i] = vtx;
+        cooked.minBounds = min(cooked.minBounds, vtx.position);
+        cooked.maxBounds = max(cooked.maxBounds, vtx.position);
+    }
+
+    for (unsigned i=0; i < mesh->mNumFaces; i++)
+    {
+        aiFace face = mesh->mFaces[i];
+        for (unsigned j=0; j < face.mNumIndices; j++)
+            cooked.indices.push_back(face.mIndices[j]);
+    }
+
+    // Reorder the triangles & vertices for the GPU's caches - this doesn't move any of the vertices,
+    // so the bounds stay the same
+    optimizeMesh(cooked.name, cooked.vertices, cooked.indices);
+    return cooked;
+}
+
+static void importMeshesRecursively(vector<CookedMesh>& meshes, aiNode* node, const aiScene* aiscene)
+{
+    // Process all the meshes
+    for (unsigned i=0; i < node->mNumMeshes; i++)
+        meshes.push_back(importMesh(aiscene->mMeshes[node->mMeshes[i]]));
+
+    // Recurse on the node's children
+    for (unsigned i=0; i < node->mNumChildren; i++)
+        importMeshesRecursively(meshes, node->mChildren[i], aiscene);
+}
+
+bool CookedModel::cook(const string& source)
+{
+    // Load the model into an assimp scene object
+    Assimp::Importer importer;
+    importer.SetIOHandler(new FileSystemIO());   // the importer deletes it
+    const aiScene* aiscene = importer.ReadFile(source, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices);
+
+    if (!aiscene || aiscene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !aiscene->mRootNode) {
+        cout << "Error loading model at " << source << ": " << importer.GetErrorString() << endl;
+        return false;
+    }
+
+    meshes.clear();
+    importMeshesRecursively(meshes, aiscene->mRootNode, aiscene);
+
+    // Write out the cooked file for next time
+    CookedModelHeader header;
+    if (!stampSource(source, header.source)) return true;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.meshCount = (uint32_t) meshes.size();
+
+    vector<CookedMeshEntry> entries;
+    vector<MeshVertex> vertices;
+    vector<GLuint> indices;
+    string names;
+    for (CookedMesh& mesh : meshes) {
+        CookedMeshEntry entry;
+        entry.firstVertex = (uint32_t) vertices.size();
+        entry.vertexCount = (uint32_t) mesh.vertices.size();
+        entry.firstIndex = (uint32_t) indices.size();
+        entry.indexCount = (uint32_t) mesh.indices.size();
+        entry.nameOffset = (uint32_t) names.size();
+        entry.nameLength = (uint32_t) mesh.name.size();
+        for (int k=0; k<3; k++) {
+            entry.minBounds[k] = mesh.minBounds[k];
+            entry.maxBounds[k] = mesh.maxBounds[k];
+        }
+        entries.push_back(entry);
+
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+        names += mesh.name;
+    }
+    header.vertexCount = (uint32_t) vertices.size();
+    header.indexCount = (uint32_t) indices.size();
+    header.namesSize = (uint32_t) names.size();
+
+    writeCookedFile(cookedPath(source, ".mdl"), {
+        { &header, sizeof(header) },
+        { entries.data(), entries.size() * sizeof(CookedMeshEntry) },
+        { vertices.data(), vertices.size() * sizeof(MeshVertex) },
+        { indices.data(), indices.size() * sizeof(GLuint) },
+        { names.data(), names.size() },
+    });
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "CookedFile.hpp"
+#include "VertexFormat.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// One mesh of a model, ready to be uploaded (see Mesh::createAsset)
+struct CookedMesh {
+    std::string name;       // its diffuse texture is <model's folder>/<name>_diffuse.png
+    std::vector<MeshVertex> vertices;
+    std::vector<GLuint> indices;
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+};
+
+/*
+ A model file imported by assimp once & saved in a binary form which loads without any parsing (see
+ CookedFile.hpp). Cooking a model:
+    - merges the vertices which are exactly the same (OBJ files store every corner of every face
+      separately)
+    - reorders its triangles & vertices for the GPU (see MeshOptimizer.hpp)
+    - computes the bounding box of each of its meshes
+
+ The cooked file is laid out as: a header, a table with an entry per mesh, then every mesh's vertices,
+ every mesh's indices & finally the names of the meshes.
+ */
+struct CookedModel {
+    std::vector<CookedMesh> meshes;
+
+    // Loads the cooked file of source, if it exists & is up to date
+    bool load(const std::string& source);
+
+    // Imports source with assimp & writes out its cooked file - returns false if it can't be imported
+    bool cook(const std::string& source);
+};
@@ -0,0 +1,128 @@
+#include "CookedTexture.hpp"
+#include "FileSystem.hpp"
+#include "lodepng/lodepng.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+static const char MAGIC[4] = { 'C', 'T', 'E', 'X' };
+static const uint32_t VERSION = 2;  // bump whenever the layout below changes
+
+// Start of every cooked file, followed by the pixels
+struct CookedHeader {
+    char magic[4];
+    uint32_t version;
+    SourceStamp source;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+};
+
+CookedTexture::CookedTexture() : width(0), height(0), levels(0), pixels(nullptr), size(0), owned(nullptr)
+{}
+
+size_t CookedTexture::levelOffset(int level)
+{
+    size_t offset = 0;
+    for (int l=0; l<level; l++) offset += (size_t) levelWidth(l) * levelHeight(l) * 4;
+    return offset;
+}
+
+// Loading -------------------------------------------------------------------------------------
+
+bool CookedTexture::map(const string& source)
+{
+    SourceStamp stamp;
+    if (!stampSource(source, stamp)) return false;
+    if (!file.open(cookedPath(source, ".tex"))) return false;
+
+    // Throw the file out if it's for a different version of the source (or of this code)
+    const CookedHeader* header = (const CookedHeader*) file.data;
+    bool valid = file.size >= sizeof(CookedHeader) &&
+                 memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header->version == VERSION &&
+                 header->source.time == stamp.time &&
+                 header->source.size == stamp.size &&
+                 header->levels >= 1 && header->levels <= 32;
+    if (valid) {
+        width = header->width;
+        height = header->height;
+        levels = header->levels;
+        valid = (sizeof(CookedHeader) + levelOffset(levels) == file.size);
+    }
+    if (!valid) {
+        file.close();
+        return false;
+    }
+
+    pixels = file.data + sizeof(CookedHeader);
+    size = levelOffset(levels);
+    return true;
+}
+
+// Cooking -------------------------------------------------------------------------------------
+
+// Each texel of the next level is the average of the 2x2 texels it covers (like glGenerateMipmap)
+static void downsample(const unsigned char* src, unsigned srcW, unsigned srcH, unsigned char* dst, unsigned dstW, unsigned dstH)
+{
+    for (unsigned y=0; y<dstH; y++) {
+        for (unsigned x=0; x<dstW; x++) {
+            // Odd sizes round down, so the last row/column of texels only has itself to average with
+            unsigned x0 = std::min(2 * x, srcW - 1), x1 = std::min(2 * x + 1, srcW - 1);
+            unsigned y0 = std::min(2 * y, srcH - 1), y1 = std::min(2 * y + 1, srcH - 1);
+            for (int c=0; c<4; c++) {
+                unsigned sum = src[(y0 * srcW + x0) * 4 + c] + src[(y0 * srcW + x1) * 4 + c] +
+                               src[(y1 * srcW + x0) * 4 + c] + src[(y1 * srcW + x1) * 4 + c];
+                dst[(y * dstW + x) * 4 + c] = (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+unsigned CookedTexture::cook(const string& source)
+{
+    // Load the image in 32-bit RGBA format
+    FileView png;
+    if (!FileSystem::get().open(source, png)) return 78;    // lodepng's "failed to open file for reading"
+
+    unsigned char* image = nullptr;
+    unsigned error = lodepng_decode32(&image, &width, &height, png.data, png.size);
+    png.release();
+    if (error) return error;
+
+    levels = 1;
+    while (levelWidth(levels - 1) > 1 || levelHeight(levels - 1) > 1) levels++;
+
+    size = levelOffset(levels);
+    owned = (unsigned char*) malloc(size);
+    pixels = owned;
+    memcpy(owned, image, (size_t) width * height * 4);
+    free(image);
+
+    for (int l=1; l<levels; l++)
+        downsample(owned + levelOffset(l - 1), levelWidth(l - 1), levelHeight(l - 1),
+                   owned + levelOffset(l), levelWidth(l), levelHeight(l));
+
+    // Write out the cooked file for next time
+    CookedHeader header;
+    if (!stampSource(source, header.source)) return 0;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.width = width;
+    header.height = height;
+    header.levels = levels;
+    writeCookedFile(cookedPath(source, ".tex"), { { &header, sizeof(header) }, { owned, size } });
+
+    return 0;
+}
+
+void CookedTexture::release()
+{
+    file.close();
+    free(owned);
+    owned = nullptr;
+    pixels = nullptr;
+}
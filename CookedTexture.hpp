@@ -0,0 +1,39 @@
+#pragma once
+
+#include "CookedFile.hpp"
+#include <string>
+#include <cstddef>
+
+/*
+ A PNG converted into the form OpenGL wants it in: RGBA8 pixels, followed by every level of its mip
+ chain down to 1x1 (textures which aren't mipmapped only upload the first level). The first time a
+ texture gets loaded it is cooked (see CookedFile.hpp), & on the next launches that file is memory
+ mapped instead: the pixels can be copied straight out of it, without decoding the PNG or computing
+ any mipmaps.
+
+ Note: block compression (DXT/BC) isn't used, since it's only an extension in OpenGL 3.3
+ */
+struct CookedTexture {
+    unsigned width, height;     // of level 0
+    int levels;
+    const unsigned char* pixels;    // every level, one after the other
+    size_t size;                    // in bytes, of all the levels
+
+    // Either one of these holds the pixels
+    MappedFile file;
+    unsigned char* owned;
+
+    CookedTexture();
+
+    // Maps the cooked file of source in, if it exists & is up to date
+    bool map(const std::string& source);
+
+    // Decodes source, computes its mip chain & writes out its cooked file - returns lodepng's error code
+    unsigned cook(const std::string& source);
+
+    void release();
+
+    unsigned levelWidth(int level)  { return width > (1u << level) ? width >> level : 1; };
+    unsigned levelHeight(int level) { return height > (1u << level) ? height >> level : 1; };
+    size_t levelOffset(int level);  // in bytes, from the start of pixels
+};
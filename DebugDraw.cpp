@@ -0,0 +1,146 @@
+#include "DebugDraw.hpp"
+#include "GLState.hpp"
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cstddef>
+
+using namespace std;
+using namespace glm;
+
+DebugDraw& DebugDraw::get()
+{
+    static DebugDraw debugDraw;
+    return debugDraw;
+}
+
+DebugDraw::DebugDraw() : m_shader(nullptr), m_vao(0), m_vbo(0), m_capacity(0) {}
+
+DebugDraw::~DebugDraw()
+{
+    if (m_vao) glDeleteVertexArrays(1, &m_vao);
+    if (m_vbo) glDeleteBuffers(1, &m_vbo);
+}
+
+void DebugDraw::init(Shader* shader)
+{
+    m_shader = shader;
+
+    // The vertex buffer gets filled in every frame, so it starts out empty
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+    // Tell OpenGL where to find/how to interpret...
+    //      1) The position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    //      2) The colour
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineVertex), (void*)offsetof(LineVertex, colour));
+    glEnableVertexAttribArray(1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    GLState::get().invalidate();
+    CHECK_GL_ERRORS;
+}
+
+// Shapes --------------------------------------------------------------------------------------
+
+void DebugDraw::line(vec3 from, vec3 to, vec4 colour)
+{
+    uint32_t packed = packUnorm4x8(colour);
+    m_vertices.push_back({ from, packed });
+    m_vertices.push_back({ to, packed });
+}
+
+// The 12 edges between 8 corners, numbered so that bit 0 is x, bit 1 is y & bit 2 is z (of the
+// corner being on the max side)
+static const int BOX_EDGES[12][2] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },     // along x
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },     // along y
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },     // along z
+};
+
+void DebugDraw::box(vec3 min, vec3 max, vec4 colour, const mat4& model)
+{
+    vec3 corners[8];
+    for (int i=0; i<8; i++) {
+        vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+        corners[i] = vec3(model * vec4(corner, 1.0f));
+    }
+
+    for (auto& edge : BOX_EDGES) line(corners[edge[0]], corners[edge[1]], colour);
+}
+
+void DebugDraw::sphere(vec3 center, float radius, vec4 colour)
+{
+    for (int axis=0; axis<3; axis++) {
+        // The circle lies in the plane of the 2 other axes
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+
+        vec3 previous = center;
+        previous[u] += radius;
+        for (int i=1; i<=SPHERE_SEGMENTS; i++) {
+            float angle = i * two_pi<float>() / SPHERE_SEGMENTS;
+            vec3 point = center;
+            point[u] += radius * cos(angle);
+            point[v] += radius * sin(angle);
+
+            line(previous, point, colour);
+            previous = point;
+        }
+    }
+}
+
+void DebugDraw::frustum(const mat4& viewProj, vec4 colour)
+{
+    // The frustum is the cube from -1 to 1 in clip space, taken back into world space
+    mat4 toWorld = inverse(viewProj);
+    vec3 corners[8];
+    for (int i=0; i<8; i++) {
+        vec4 corner = toWorld * vec4((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1, 1.0f);
+        corners[i] = vec3(corner) / corner.w;
+    }
+
+    for (auto& edge : BOX_EDGES) line(corners[edge[0]], corners[edge[1]], colour);
+}
+
+// Drawing -------------------------------------------------------------------------------------
+
+void DebugDraw::submit(RenderQueue& queue)
+{
+    if (m_vertices.empty() || !m_shader) {
+        m_vertices.clear();
+        return;
+    }
+
+    // Give the buffer fresh storage every frame so that we never have to wait on the GPU to be
+    // done with last frame's lines
+    GLsizeiptr size = m_vertices.size() * sizeof(LineVertex);
+    if (size > m_capacity) m_capacity = std::max(size, 2 * m_capacity);
+    GLState::get().bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_capacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_vertices.data());
+
+    DrawPacket packet;
+    packet.shader = m_shader;
+    packet.vao = m_vao;
+
+    packet.primitive = GL_LINES;
+    packet.count = (GLsizei) m_vertices.size();
+
+    packet.layer = LAYER_OVERLAY;
+    packet.blend = BLEND_ALPHA;
+    packet.depthWrite = false;
+
+    queue.submit(packet);
+
+    m_vertices.clear();
+    CHECK_GL_ERRORS;
+}
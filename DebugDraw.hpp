@@ -0,0 +1,58 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "RenderQueue.hpp"
+#include "Shader.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+/*
+ Immediate mode debug drawing: anything (the scene, the culling, the shadow cascades...) can queue up
+ wireframe shapes in world space from anywhere during the frame, & they all get drawn at the end of
+ the regular pass - written into one streamed vertex buffer, then drawn with a single GL_LINES draw
+ call. Nothing is kept from one frame to the next, so a shape has to be queued every frame it should
+ be visible for.
+
+ Costs nothing while nothing is being drawn: there's no per-object geometry, only the one buffer.
+ */
+class DebugDraw {
+    static const int SPHERE_SEGMENTS = 24;  // per circle
+
+    struct LineVertex {
+        glm::vec3 position;
+        uint32_t colour;    // RGBA, 8 bits each
+    };
+
+    Shader* m_shader;
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLsizeiptr m_capacity;  // of m_vbo, in bytes
+
+    std::vector<LineVertex> m_vertices;     // queued since the last submit
+
+    DebugDraw();
+
+public:
+    static DebugDraw& get();
+    ~DebugDraw();
+
+    // Must be called once the GL context exists - nothing gets drawn until then
+    void init(Shader* shader);
+
+    void line(glm::vec3 from, glm::vec3 to, glm::vec4 colour);
+
+    // A box in model space, ie. a mesh's bounding box
+    void box(glm::vec3 min, glm::vec3 max, glm::vec4 colour, const glm::mat4& model = glm::mat4(1.0f));
+
+    // 3 circles, one around each axis
+    void sphere(glm::vec3 center, float radius, glm::vec4 colour);
+
+    // The volume visible through a view & projection matrix (ie. a camera's, or a shadow cascade's)
+    void frustum(const glm::mat4& viewProj, glm::vec4 colour);
+
+    // Queues up all of the lines for a single draw call, drawn over the rest of the scene (but still
+    // depth tested against it), then starts over for the next frame
+    void submit(RenderQueue& queue);
+};
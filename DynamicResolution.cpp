@@ -0,0 +1,61 @@
+#include "DynamicResolution.hpp"
+#include <algorithm>
+#include <cmath>
+
+static const float STEP = 0.125f;           // scales are multiples of 1/8 of the window size
+static const float SMOOTHING = 0.1f;        // weight of the newest frame in the running average
+static const float OVER_BUDGET = 1.05f;     // frames more than 5% too slow lower the scale...
+static const float UNDER_BUDGET = 1.01f;    // ... & frames which make it raise it, after a while
+static const int FRAMES_TO_RAISE = 120;
+static const int COOLDOWN_FRAMES = 30;
+
+DynamicResolution::DynamicResolution(float initialScale, float minScale, float maxScale) :
+    m_enabled(false), m_targetFPS(60.0f), m_minScale(minScale), m_maxScale(maxScale),
+    m_scale(initialScale), m_frameTime(0.0f), m_cooldown(0), m_fastFrames(0)
+{
+    
+}
+
+float DynamicResolution::update(float frameTime)
+{
+    // Hitches (ie. dragging the window around) would throw the average off for a long time
+    frameTime = std::min(frameTime, 0.25f);
+    
+    if (m_frameTime == 0.0f)    m_frameTime = frameTime;
+    else                        m_frameTime += (frameTime - m_frameTime) * SMOOTHING;
+    
+    if (!m_enabled) return m_scale;
+    
+    if (m_cooldown > 0) {
+        m_cooldown--;
+        return m_scale;
+    }
+    
+    /*
+     With vsync on, a frame can never be faster than the refresh rate, so we can't tell how much
+     headroom we have - frames that merely make the budget count towards raising the scale, & if the
+     raise turns out to be too much, it'll simply get undone a little later.
+     */
+    float budget = 1.0f / m_targetFPS;
+    float scale = m_scale;
+    
+    if (m_frameTime > budget * OVER_BUDGET) {
+        // Cut the number of pixels by a step, more if we're way over budget
+        float steps = (m_frameTime > budget * 1.5f) ? 2.0f : 1.0f;
+        scale = m_scale - steps * STEP;
+        m_fastFrames = 0;
+    }
+    else if (m_frameTime <= budget * UNDER_BUDGET && ++m_fastFrames >= FRAMES_TO_RAISE) {
+        scale = m_scale + STEP;
+        m_fastFrames = 0;
+    }
+    
+    scale = std::round(scale / STEP) * STEP;
+    scale = std::max(m_minScale, std::min(m_maxScale, scale));
+    if (scale != m_scale) {
+        m_scale = scale;
+        m_cooldown = COOLDOWN_FRAMES;
+    }
+    
+    return m_scale;
+}
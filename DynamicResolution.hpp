@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+ Picks the scale of the water's render targets from frame to frame so that the game holds a target
+ frame rate: the scale drops as soon as frames take too long, & creeps back up once they've been
+ fast enough for a while.
+ 
+ Every change of scale reallocates the targets, so the scale moves in fixed steps & waits a little
+ after each change to see its effect before changing again.
+ */
+class DynamicResolution {
+    bool m_enabled;
+    float m_targetFPS;
+    float m_minScale;
+    float m_maxScale;
+    
+    float m_scale;
+    float m_frameTime;          // smoothed, in seconds
+    int m_cooldown;             // frames left before the scale may change again
+    int m_fastFrames;           // consecutive frames which were within budget
+    
+public:
+    DynamicResolution(float initialScale, float minScale = 0.25f, float maxScale = 1.0f);
+    
+    // Call once per frame with the time the last frame took (in seconds) - returns the scale to use
+    float update(float frameTime);
+    
+    void setEnabled(bool b)             { m_enabled = b; };
+    void setTargetFPS(float fps)        { m_targetFPS = fps; };
+    void setScale(float scale)          { m_scale = scale; };
+    
+    float scale()                       { return m_scale; };
+    float smoothedFrameTime()           { return m_frameTime; };
+};
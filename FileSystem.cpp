@@ -0,0 +1,189 @@
+#include "FileSystem.hpp"
+#include "lodepng/lodepng.h"
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+void FileView::release()
+{
+    mapped.close();
+    free(owned);
+    owned = nullptr;
+    data = nullptr;
+    size = 0;
+}
+
+FileSystem& FileSystem::get()
+{
+    static FileSystem fileSystem;
+    return fileSystem;
+}
+
+string FileSystem::normalize(const string& path)
+{
+    vector<string> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find_first_of("/\\", start);
+        if (end == string::npos) end = path.size();
+
+        string part = path.substr(start, end - start);
+        if (part == ".." && !parts.empty() && parts.back() != "..")
+            parts.pop_back();
+        else if (!part.empty() && part != ".")
+            parts.push_back(part);
+        start = end + 1;
+    }
+
+    string normalized = (!path.empty() && path[0] == '/') ? "/" : "";
+    for (size_t i=0; i<parts.size(); i++)
+        normalized += (i ? "/" : "") + parts[i];
+    return normalized;
+}
+
+// Archive -------------------------------------------------------------------------------------
+
+bool FileSystem::mount(const string& archive)
+{
+    if (!m_archive.open(archive)) return false;
+
+    // Make sure every entry lies within the file before trusting any of them
+    const PackHeader* header = (const PackHeader*) m_archive.data;
+    const PackEntry* entries = (const PackEntry*) (m_archive.data + sizeof(PackHeader));
+    bool valid = m_archive.size >= sizeof(PackHeader) &&
+                 memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 &&
+                 header->version == PACK_VERSION &&
+                 sizeof(PackHeader) + (uint64_t) header->entryCount * sizeof(PackEntry) + header->pathsSize <= m_archive.size;
+
+    const char* paths = valid ? (const char*) (entries + header->entryCount) : nullptr;
+    for (uint32_t i=0; valid && i<header->entryCount; i++) {
+        const PackEntry& entry = entries[i];
+        valid = entry.offset <= m_archive.size && entry.storedSize <= m_archive.size - entry.offset &&
+                (uint64_t) entry.pathOffset + entry.pathLength <= header->pathsSize &&
+                (entry.compression == PACK_ZLIB || (entry.compression == PACK_STORED && entry.storedSize == entry.size));
+        if (valid) m_entries[string(paths + entry.pathOffset, entry.pathLength)] = &entry;
+    }
+
+    if (!valid) {
+        cerr << "Error mounting " << archive << ": it isn't a valid archive" << endl;
+        m_entries.clear();
+        m_archive.close();
+        return false;
+    }
+    return true;
+}
+
+const PackEntry* FileSystem::find(const string& path) const
+{
+    if (m_entries.empty()) return nullptr;
+
+    auto it = m_entries.find(normalize(path));
+    return (it == m_entries.end()) ? nullptr : it->second;
+}
+
+// Files ---------------------------------------------------------------------------------------
+
+bool FileSystem::exists(const string& path) const
+{
+    if (find(path)) return true;
+
+    struct stat info;
+    return stat(normalize(path).c_str(), &info) == 0 && S_ISREG(info.st_mode);
+}
+
+bool FileSystem::open(const string& path, FileView& view) const
+{
+    const PackEntry* entry = find(path);
+    if (!entry) {
+        if (!view.mapped.open(normalize(path))) return false;
+        view.data = view.mapped.data;
+        view.size = view.mapped.size;
+        return true;
+    }
+
+    const unsigned char* stored = m_archive.data + entry->offset;
+    if (entry->compression == PACK_STORED) {
+        view.data = stored;
+        view.size = entry->size;
+        return true;
+    }
+
+    size_t size = 0;
+    unsigned error = lodepng_zlib_decompress(&view.owned, &size, stored, entry->storedSize,
+                                             &lodepng_default_decompress_settings);
+    if (error || size != entry->size) {
+        cerr << "Error decompressing " << path << " from the archive. " << error << ": " << lodepng_error_text(error) << endl;
+        view.release();
+        return false;
+    }
+    view.data = view.owned;
+    view.size = size;
+    return true;
+}
+
+bool FileSystem::stamp(const string& path, SourceStamp& stamp) const
+{
+    if (const PackEntry* entry = find(path)) {
+        stamp = entry->source;
+        return true;
+    }
+
+    struct stat info;
+    if (stat(normalize(path).c_str(), &info) != 0) return false;
+
+    stamp.time = info.st_mtime;
+    stamp.size = info.st_size;
+    return true;
+}
+
+vector<string> FileSystem::list(const string& directory, const string& extension) const
+{
+    string prefix = normalize(directory) + "/";
+    auto matches = [&](const string& name) {
+        return name.size() > extension.size() && name.find('/') == string::npos &&
+               name.compare(name.size() - extension.size(), extension.size(), extension) == 0;
+    };
+
+    vector<string> names;
+    for (auto& entry : m_entries) {
+        const string& path = entry.first;
+        if (path.compare(0, prefix.size(), prefix) == 0 && matches(path.substr(prefix.size())))
+            names.push_back(path.substr(prefix.size()));
+    }
+
+    if (DIR* d = opendir(prefix.c_str())) {
+        while (dirent* entry = readdir(d))
+            if (entry->d_name[0] != '.' && matches(entry->d_name)) names.push_back(entry->d_name);
+        closedir(d);
+    }
+
+    // A loose file which is also in the archive is only listed once
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
+// Note: only files in the archive get prefetched - the OS reads loose files ahead on its own once
+// they've been opened
+void FileSystem::prefetch(const string& path) const
+{
+    string file = normalize(path);
+    string prefix = file + "/";
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    for (auto& entry : m_entries) {
+        if (entry.first != file && entry.first.compare(0, prefix.size(), prefix) != 0) continue;
+
+        // madvise() wants a page aligned address, which every entry already starts on
+        uintptr_t start = (uintptr_t) (m_archive.data + entry.second->offset);
+        uintptr_t aligned = start & ~(uintptr_t) (pageSize - 1);
+        madvise((void*) aligned, entry.second->storedSize + (start - aligned), MADV_WILLNEED);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "CookedFile.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ The asset archive (Assets.pack, built by Tools/AssetPacker): every file the game loads, in a single
+ file which gets memory mapped once. It is laid out as:
+    - a header
+    - a table with an entry per file, sorted by path
+    - the paths, one after the other (not null terminated)
+    - the files' bytes, each one starting at a multiple of PACK_ALIGNMENT
+ Files which shrink enough are zlib compressed (with lodepng's deflate); the rest (ie. PNGs, which
+ are already compressed) are stored as is & can be read straight out of the mapping.
+ */
+static const char PACK_MAGIC[4] = { 'P', 'A', 'C', 'K' };
+static const uint32_t PACK_VERSION = 1;
+static const uint64_t PACK_ALIGNMENT = 4096;    // a page, so that each file can be prefetched on its own
+
+enum PackCompression : uint32_t {
+    PACK_STORED = 0,
+    PACK_ZLIB
+};
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t pathsSize;     // in bytes
+};
+
+struct PackEntry {
+    uint64_t offset;        // from the start of the archive
+    uint64_t storedSize;    // in the archive
+    uint64_t size;          // once decompressed
+    uint32_t pathOffset;    // into the paths
+    uint32_t pathLength;
+    uint32_t compression;   // PackCompression
+    uint32_t padding;
+    SourceStamp source;     // of the file it was packed from, so that cooked assets stay valid
+};
+
+// The bytes of a file: either a view straight into the archive (or into the mapped loose file), or
+// a buffer holding the decompressed file
+// Note: like MappedFile, the view has to be released once it's no longer needed
+struct FileView {
+    const unsigned char* data;
+    size_t size;
+
+    MappedFile mapped;
+    unsigned char* owned;
+
+    FileView() : data(nullptr), size(0), owned(nullptr) {};
+    void release();
+};
+
+/*
+ Every asset gets read through here, by its path relative to the game's folder (ie. "Assets/sun.png").
+ Files are looked up in the mounted archive first, & then on disk - so the game still runs without an
+ archive, & a loose file can be dropped in next to it while working on an asset.
+
+ Paths get normalized ("Assets/Rock/./Rock.mtl" is "Assets/Rock/Rock.mtl"), so it doesn't matter how
+ the loaders (ie. assimp, when it looks for a model's materials) spell them.
+ Note: the archive can't change once it's mounted, so every lookup is safe from any thread
+ */
+class FileSystem {
+    MappedFile m_archive;
+    std::unordered_map<std::string, const PackEntry*> m_entries;   // by path
+
+    FileSystem() {};
+
+    const PackEntry* find(const std::string& path) const;
+
+public:
+    static FileSystem& get();
+
+    // Maps the archive in - returns false if it's missing or broken, in which case every file keeps
+    // getting read from disk
+    bool mount(const std::string& archive);
+    bool mounted() const        { return m_archive.data != nullptr; };
+
+    bool exists(const std::string& path) const;
+    bool open(const std::string& path, FileView& view) const;
+
+    // Modification time & size of the file (of its source, for a file in the archive)
+    bool stamp(const std::string& path, SourceStamp& stamp) const;
+
+    // Names (not paths) of the files directly inside directory which end with extension, in
+    // alphabetical order
+    std::vector<std::string> list(const std::string& directory, const std::string& extension) const;
+
+    // Hints that the file, or every file under the directory, is about to be read, so that the OS
+    // starts reading it in the background
+    void prefetch(const std::string& path) const;
+
+    static std::string normalize(const std::string& path);
+};
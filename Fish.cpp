@@ -1,11 +1,14 @@
 #include "Model.hpp"
 #include "Scene.hpp"
 #include <string>
+#include <chrono>
 
 using namespace std;
 using namespace glm;
 
-Fish::Fish(ShaderProgram* shader, Scene* scene, int id) : Model(shader, scene, "Assets/Fish/fish.obj"), m_id(id)
+const char* const Fish::MODEL_PATH = "Assets/Fish/fish.obj";
+
+Fish::Fish(Shader* shader, Scene* scene, int id) : Model(shader, scene, MODEL_PATH), m_id(id)
 {
     // Initialize our random number generator
     auto seed = chrono::high_resolution_clock::now().time_since_epoch().count();
@@ -0,0 +1,146 @@
+#include "FishSchool.hpp"
+#include "Scene.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+static const GLuint INSTANCE_LOCATION = 4;  // the mat4 takes up locations 4-7
+
+FishSchool::FishSchool(Scene* scene, Fish* prototype) : Renderable(),
+    m_scene(scene), m_meshes(prototype->meshes()), m_capacity(0), m_numInstances(0)
+{
+    glGenBuffers(1, &m_instanceVBO);
+    
+    for (int i=0; i<(int) m_meshes.size(); i++) {
+        AABB bounds(m_meshes[i]->m_asset->minBounds, m_meshes[i]->m_asset->maxBounds);
+        if (i == 0) m_localBounds = bounds;
+        else        m_localBounds.expand(bounds);
+    }
+    
+    for (Mesh* mesh : m_meshes) {
+        GLuint vao;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        
+        // Tell OpenGL where to find/how to interpret...
+        //      1) The mesh's vertex data (same layout as in Mesh::createAsset)
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->m_asset->vbo);
+        PackedVertex::setAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->m_asset->ebo);
+        
+        //      2) The instance data
+        setInstanceAttributes();
+        m_vaos.push_back(vao);
+        
+        // The shadow pass only needs the positions (see MeshAsset)
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh->m_asset->positionVbo);
+        PackedVertex::setPositionAttribute();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->m_asset->ebo);
+        setInstanceAttributes();
+        m_shadowVaos.push_back(vao);
+    }
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::get().invalidate();
+    
+    CHECK_GL_ERRORS;
+}
+
+// A mat4 is passed as 4 vec4 attributes, which only advance once per instance rather than once
+// per vertex (the VAO they're for must be bound)
+void FishSchool::setInstanceAttributes()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    for (GLuint i=0; i<4; i++) {
+        glVertexAttribPointer(INSTANCE_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(vec4) * i));
+        glEnableVertexAttribArray(INSTANCE_LOCATION + i);
+        glVertexAttribDivisor(INSTANCE_LOCATION + i, 1);
+    }
+}
+
+FishSchool::~FishSchool()
+{
+    for (GLuint vao : m_vaos) glDeleteVertexArrays(1, &vao);
+    for (GLuint vao : m_shadowVaos) glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &m_instanceVBO);
+}
+
+void FishSchool::update()
+{
+    // Caught fish aren't part of the scene's fish anymore, so they simply stop being drawn
+    m_matrices.clear();
+    m_bounds.clear();
+    for (Fish* fish : m_scene->fish()) {
+        mat4 model = fish->modelMatrix();
+        m_matrices.push_back(model);
+        m_bounds.push_back(AABB::transform(model, m_localBounds.min, m_localBounds.max));
+    }
+}
+
+// Streams the matrices of the fish which are visible in the current pass into the instance buffer
+// Note: the previous pass' draws are still using the buffer, so it gets orphaned every time
+void FishSchool::uploadVisibleInstances(RenderQueue& queue)
+{
+    m_instances.clear();
+    for (int i=0; i<(int) m_matrices.size(); i++)
+        if (queue.isVisible(m_bounds[i])) m_instances.push_back(m_matrices[i]);
+    m_numInstances = (int) m_instances.size();
+    if (m_numInstances == 0) return;
+    
+    GLState::get().bindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    if (m_numInstances > m_capacity) {
+        // Grow the buffer (by more than we need, so that this doesn't happen every time)
+        m_capacity = std::max(m_numInstances, m_capacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(mat4), NULL, GL_STREAM_DRAW);
+    } else {
+        // Orphan the old contents so we don't have to wait for last frame's draws to finish
+        glBufferData(GL_ARRAY_BUFFER, m_capacity * sizeof(mat4), NULL, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_numInstances * sizeof(mat4), m_instances.data());
+    
+    CHECK_GL_ERRORS;
+}
+
+void FishSchool::submitMeshes(RenderQueue& queue, Mode m, bool shadowMap)
+{
+    uploadVisibleInstances(queue);
+    if (m_numInstances == 0) return;
+    
+    for (int i=0; i<(int) m_meshes.size(); i++) {
+        Mesh* mesh = m_meshes[i];
+        
+        DrawPacket packet;
+        packet.vao = shadowMap ? m_shadowVaos[i] : m_vaos[i];
+        packet.uniforms = mesh->objectUniforms(m);  // material & flags - the model matrix is per instance
+        packet.uniforms.flags.z = true;             // is instanced
+        
+        if (shadowMap) {
+            packet.shader = m_scene->shadowShader();
+        } else {
+            packet.shader = mesh->m_shader;
+            packet.addTexture(GL_TEXTURE_2D, mesh->m_textureIDs[0]);   // texture unit 0
+        }
+        
+        packet.primitive = GL_TRIANGLES;
+        packet.count = mesh->m_numIndices;
+        packet.indexType = mesh->m_asset->indexType;
+        packet.instances = m_numInstances;
+        
+        queue.submit(packet);
+    }
+}
+
+void FishSchool::submit(RenderQueue& queue, Mode m)
+{
+    submitMeshes(queue, m, false);
+}
+
+void FishSchool::submitToShadowMap(RenderQueue& queue)
+{
+    submitMeshes(queue, SHADOW_MAP, true);
+}
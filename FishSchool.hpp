@@ -0,0 +1,47 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "Renderable.hpp"
+#include "Model.hpp"
+
+/*
+ Draws every fish in the scene with one instanced draw call per fish mesh, rather than one draw call
+ per mesh per fish. The Fish objects still handle the game logic (swimming, collisions, getting caught),
+ but they don't render themselves anymore - every pass, the model matrices of the fish which pass the
+ frustum test are streamed into an instance buffer which feeds the "InstanceModel" attribute of the
+ object & shadow map shaders.
+ */
+class FishSchool : public Renderable {
+    Scene* m_scene;
+    
+    // The meshes of the fish used as the template for all of the others
+    // Note: all fish are loaded from the same file, so their meshes are identical
+    std::vector<Mesh*> m_meshes;
+    std::vector<GLuint> m_vaos;     // one per mesh: its vertex data + the instance data
+    std::vector<GLuint> m_shadowVaos;   // same, with only the positions of the vertices
+    
+    AABB m_localBounds;             // of all the meshes together, in model space
+    
+    // Updated once per frame
+    std::vector<glm::mat4> m_matrices;
+    std::vector<AABB> m_bounds;     // in world space
+    
+    GLuint m_instanceVBO;
+    int m_capacity;                 // number of matrices the instance buffer can currently hold
+    int m_numInstances;             // visible in the current pass
+    std::vector<glm::mat4> m_instances;
+    
+    void setInstanceAttributes();
+    void uploadVisibleInstances(RenderQueue& queue);
+    void submitMeshes(RenderQueue& queue, Mode m, bool shadowMap);
+    
+public:
+    FishSchool(Scene* scene, Fish* prototype);
+    ~FishSchool();
+    
+    void update();  // must be called once per frame, after the fish have moved
+    
+    void submit(RenderQueue& queue, Mode m) final;
+    void submitToShadowMap(RenderQueue& queue) final;
+};
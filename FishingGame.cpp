@@ -4,22 +4,37 @@
 #include "Renderable.hpp"
 #include "LensFlare.hpp"
 #include "Scene.hpp"
+#include "GLState.hpp"
+#include "TextureLoader.hpp"
+#include "ModelAsset.hpp"
+#include "ThreadPool.hpp"
+#include "FileSystem.hpp"
+#include "DebugDraw.hpp"
 #include <imgui/imgui.h>
 #include <iostream>
 
 using namespace std;
 using namespace glm;
 
+static const int NUM_FISH = 10;   // rendering cost stays about the same no matter how many there are
+static const double LOADING_TIME_PER_FRAME = 0.008;     // in seconds, of uploads on the main thread
+
 FishingGame::FishingGame() :
     m_mouseDown(false),
     m_showSettings(false),
     m_thirdPersonView(true),
     m_renderBoundingBoxes(false),
+    m_renderShadowCascades(false),
+    m_currMode(Mode::REGULAR),
     m_waterDistortion(0.63f),
     m_bumpMapping(true),
     m_skyboxRotationSpeed(0.1f),
-    m_currMode(Mode::REGULAR),
-    m_currScore(0)
+    m_terrainLodError(2.0f),
+    m_dynamicResolution(false),
+    m_targetFPS(60.0f),
+    m_resolution(0.5f),     // same as the scene's initial water scale
+    m_currScore(0),
+    m_loaded(false)
 {}
 
 FishingGame::~FishingGame()
@@ -33,70 +48,95 @@ FishingGame::~FishingGame()
  */
 void FishingGame::init()
 {
+    // Every asset gets read out of the archive if there is one, otherwise from the Assets folder
+    // Nearly all of the archive is needed before the first frame, so the OS can start reading it in
+    // right away
+    if (FileSystem::get().mount("Assets.pack")) cout << "Loading assets from Assets.pack" << endl;
+    FileSystem::get().prefetch("Assets");
+
     glfwGetFramebufferSize(m_window, &m_framebufferWidth, &m_framebufferHeight);
     
     double xpos, ypos;
     glfwGetCursorPos(m_window, &xpos, &ypos);
     m_lastMousePos = vec2(xpos, ypos);
 
+    // Start compiling all of the shaders - the driver works on them while everything else loads,
+    // they only get waited on the first time they're used (see Shader::link)
+    Shader* shadowShader = generateShader("ShadowMapVtxShader.vs", "ShadowMapFragShader.fs", "ShadowMapGeomShader.gs");
+    Shader* debugDrawShader = generateShader("DebugDrawVtxShader.vs", "DebugDrawFragShader.fs");
+    Shader* image2DShader = generateShader("2DImageVtxShader.vs", "2DImageFragShader.fs");
+    Shader* spriteShader = generateShader("SpriteVtxShader.vs", "SpriteFragShader.fs");
+    Shader* skyboxShader = generateShader("SkyboxVtxShader.vs", "SkyboxFragShader.fs");
+    Shader* waterShader = generateShader("WaterVtxShader.vs", "WaterFragShader.fs");
+    Shader* objectShader = generateShader("ObjectVertexShader.vs", "ObjectFragmentShader.fs");
+    
     // Initialize the scene
     m_scene = new Scene(new Camera(m_framebufferWidth, m_framebufferHeight),
-                        m_framebufferWidth, m_framebufferHeight,
-                        generateShader("ShadowMapVtxShader.vs", "ShadowMapFragShader.fs"));
-    
-    // Create the shaders
-    ShaderProgram* image2DShader = generateShader("2DImageVtxShader.vs", "2DImageFragShader.fs");
-    ShaderProgram* skyboxShader = generateShader("SkyboxVtxShader.vs", "SkyboxFragShader.fs");
-    ShaderProgram* waterShader = generateShader("WaterVtxShader.vs", "WaterFragShader.fs");
-    ShaderProgram* objectShader = generateShader("ObjectVertexShader.vs", "ObjectFragmentShader.fs");
+                        m_framebufferWidth, m_framebufferHeight, shadowShader);
+    DebugDraw::get().init(debugDrawShader);
     
-    // Create the renderables and add them to the scene
-    Sun* s = new Sun(image2DShader, m_scene);
-        s->setSize(2000.0f);
-        m_scene->setSun(s);
+    /*
+     Everything else gets loaded while the loading screen is up (see appLogic): the files get read &
+     decoded on the worker threads, & only the GL objects get created here, on the main thread. The
+     sun, skybox & water don't have any work of their own, their textures load in the background
+     (see TextureLoader).
+     */
+    m_loading.add("sky", nullptr, [=]() {
+        Sun* s = new Sun(image2DShader, m_scene);
+            s->setSize(2000.0f);
+            m_scene->setSun(s);
+        
+        Skybox* sk = new Skybox(skyboxShader, m_scene, m_skyboxRotationSpeed);
+            m_scene->setSkybox(sk);
+    });
     
-    LensFlare* l = new LensFlare(image2DShader, m_scene);
-        m_scene->setLensFlare(l);
+    m_loading.add("water", nullptr, [=]() {
+        Water* w = new Water(waterShader, m_scene);
+            w->setSize(500);
+            m_scene->setWater(w);
+    });
     
-    Skybox* sk = new Skybox(skyboxShader, m_scene, m_skyboxRotationSpeed);
-        m_scene->setSkybox(sk);
+    // All of the 2D images get packed into one texture atlas
+    SpriteBatch* sprites = new SpriteBatch(spriteShader);
+        m_scene->setSprites(sprites);
+    m_loading.add("sprites", [=]() { sprites->build({ "LensFlare", "Numbers" }); }, [=]() {
+        sprites->upload();
+        
+        LensFlare* l = new LensFlare(m_scene);
+            m_scene->setLensFlare(l);
+        
+        Hud* hud = new Hud(m_scene);
+            m_scene->setHud(hud);
+    });
     
-    Water* w = new Water(waterShader, m_scene);
-        w->setSize(500);
-        m_scene->setWater(w);
-
     Terrain* t = new Terrain(objectShader, m_scene, 2000, 100);
         t->setPosition(vec3(-1 * t->getSize() / 2.0f,
                             5.2,
                             -1 * t->getSize() / 2.0f));
         m_scene->setTerrain(t);
+    LoadingPipeline::Task terrain = m_loading.add("terrain", [=]() { t->build(); }, [=]() { t->upload(); });
     
-    cout << "Loading boat model..." << endl;
-    Character* c = new Character(objectShader, m_scene);
-        c->setPosition(vec3(0, -1, 0));
-        c->setSize(1.3);
-        m_scene->setCharacter(c);
-
-    cout << "Loading fish models..." << endl;
-    for (int i=0; i<10; i++) {
-        Fish* f = new Fish(objectShader, m_scene, i);
-        f->setSize(0.3);
-        m_scene->addFish(f);
-    }
-    
-    // For the images below, note that the position is in NDC and and size is relative to the size of the screen
-    Image2D* currScore = new Image2D(image2DShader, m_scene, "Numbers/0.png", vec2(0.065f, 0.065f));
-        currScore->setPosition(vec3(0.75f, 0.9f, 0.0f));
+    m_loading.add("boat", []() { ModelAsset::prepare(Character::MODEL_PATH); }, [=]() {
+        Character* c = new Character(objectShader, m_scene);
+            c->setPosition(vec3(0, -1, 0));
+            c->setSize(1.3);
+            m_scene->setCharacter(c);
+    });
     
-    Image2D* slash = new Image2D(image2DShader, m_scene, "Numbers/Slash.png", vec2(0.05f, 0.05f));
-        slash->setPosition(vec3(0.825f, 0.8f, 0.0f));
+    // The models which get placed on the terrain are imported alongside it - only placing them has to
+    // wait for its heights
+    LoadingPipeline::Task fishModel = m_loading.add("fish model",
+                                                    []() { ModelAsset::prepare(Fish::MODEL_PATH); }, nullptr);
     
-    Image2D* outOf = new Image2D(image2DShader, m_scene, "Numbers/10.png", vec2(0.065f, 0.065f));
-        outOf->setPosition(vec3(0.9f, 0.7f, 0.0f));
-
-    m_scene->setCurrScore(currScore);
-    m_scene->addImage(outOf);
-    m_scene->addImage(slash); // render this last so the other 2 get rendered on top
+    // The fish pick their starting positions based on the depth of the water
+    m_loading.add("fish", nullptr, [=]() {
+        for (int i=0; i<NUM_FISH; i++) {
+            Fish* f = new Fish(objectShader, m_scene, i);
+            f->setSize(0.3);
+            m_scene->addFish(f);
+        }
+        m_scene->setFishSchool(new FishSchool(m_scene, m_scene->fish()[0]));
+    }, { terrain, fishModel });
     
     // Add some terrain objects to decorate the terrain
     struct TerrainObjectData {
@@ -105,43 +145,90 @@ void FishingGame::init()
         float size;
         TerrainObjectData(float x, float z, float s) : xPosition(x), zPosition(z), size(s) {};
     };
+    auto addTerrainObjects = [=](string path, vector<TerrainObjectData> objects) {
+        for (auto data : objects) {
+            TerrainObject* object = new TerrainObject(objectShader, m_scene, path);
+            object->setOnTerrain(data.xPosition, data.zPosition);
+            object->setSize(data.size);
+            m_scene->addTerrainObject(object);
+        }
+    };
     
-    cout << "Loading rock models..." << endl;
     vector<TerrainObjectData> rocks {
         TerrainObjectData(70.0f, 0.0f, 2.0f),
         TerrainObjectData(-175.0f, -135.0f, 3.7f),
     };
-    for (auto data : rocks) {
-        TerrainObject* rock = new TerrainObject(objectShader, m_scene, "Assets/Rock/Rock.obj");
-        rock->setOnTerrain(data.xPosition, data.zPosition);
-        rock->setSize(data.size);
-        m_scene->addTerrainObject(rock);
-    }
+    string rockPath = "Assets/Rock/Rock.obj";
+    LoadingPipeline::Task rockModel = m_loading.add("rock model", [=]() { ModelAsset::prepare(rockPath); },
+                                                    nullptr);
+    LoadingPipeline::Task rockTask = m_loading.add("rocks", nullptr, [=]() { addTerrainObjects(rockPath, rocks); },
+                                                   { terrain, rockModel });
     
-    cout << "Loading tree models..." << endl;
     vector<TerrainObjectData> trees {
         TerrainObjectData(-150.0f, -150.0f, 2.7f + 10.0f),
         TerrainObjectData(-300.0f, 100.0f, 3.0f + 10.0f),
         TerrainObjectData(-90.0f, 200.0f, 2.5f + 10.0f),
     };
-    for (auto data : trees) {
-//        TerrainObject* tree = new TerrainObject(objectShader, m_scene, "Assets/Tree/Tree.obj");
-        TerrainObject* tree = new TerrainObject(objectShader, m_scene, "Assets/LowPolyTree/lowpolytree.obj"); // speed increase
-        tree->setOnTerrain(data.xPosition, data.zPosition);
-        tree->setSize(data.size);
-        m_scene->addTerrainObject(tree);
+//    string treePath = "Assets/Tree/Tree.obj";
+    string treePath = "Assets/LowPolyTree/lowpolytree.obj"; // speed increase
+    LoadingPipeline::Task treeModel = m_loading.add("tree model", [=]() { ModelAsset::prepare(treePath); },
+                                                    nullptr);
+    LoadingPipeline::Task treeTask = m_loading.add("trees", nullptr, [=]() { addTerrainObjects(treePath, trees); },
+                                                   { terrain, treeModel });
+    
+    // The terrain objects never move again, so they can be merged into a few large batches
+    m_loading.add("static batches", nullptr, [=]() { m_scene->buildStaticBatches(); }, { rockTask, treeTask });
+    
+    m_loading.start();
+}
+
+// Runs part of the loading every frame, until everything (including the textures) has been loaded
+void FishingGame::updateLoading()
+{
+    // The uploads use the shaders - if the driver can tell, hold them back until it's done compiling
+    // rather than waiting on it, so that the loading screen keeps drawing meanwhile (the workers
+    // keep loading either way)
+    for (Shader* shader : m_shaders)
+        if (!shader->ready()) return;
+    
+    m_loading.update(LOADING_TIME_PER_FRAME);
+    if (m_loading.done() && TextureLoader::get().pending() == 0) {
+        m_loaded = true;
+        cout << "Ready to play!" << endl;
     }
+}
+
+// A progress bar across the middle of the screen - drawn with scissored clears, so that it doesn't
+// need any shaders or buffers
+void FishingGame::drawLoadingScreen()
+{
+    int width = m_framebufferWidth / 2;
+    int height = std::max(m_framebufferHeight / 64, 4);
+    int x = (m_framebufferWidth - width) / 2;
+    int y = (m_framebufferHeight - height) / 2;
+    
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x, y, width, height);
+    glClearColor(0.2, 0.2, 0.2, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
     
-    cout << "Ready to play!" << endl;
+    glScissor(x, y, (int) (width * m_loading.progress()), height);
+    glClearColor(0.529, 0.808, 0.922, 1.0);     // the sky's colour
+    glClear(GL_COLOR_BUFFER_BIT);
+    
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.0, 0.0, 0.0, 1.0);
 }
 
 // Helper function which generates a shader program & stores it
-ShaderProgram* FishingGame::generateShader(string vtxShader, string fragShader)
+Shader* FishingGame::generateShader(string vtxShader, string fragShader, string geomShader)
 {
-    ShaderProgram* shader = new ShaderProgram();
+    Shader* shader = new Shader();
     shader->generateProgramObject();
     shader->attachVertexShader( ("Assets/Shaders/" + vtxShader).c_str() );
     shader->attachFragmentShader( ("Assets/Shaders/" + fragShader).c_str() );
+    if (!geomShader.empty())
+        shader->attachGeometryShader( ("Assets/Shaders/" + geomShader).c_str() );
     shader->link();
     
     m_shaders.push_back(shader);
@@ -155,10 +242,27 @@ ShaderProgram* FishingGame::generateShader(string vtxShader, string fragShader)
  */
 void FishingGame::appLogic()
 {
+    // ImGui changed the GL state behind our back at the end of the last frame
+    GLState::get().beginFrame();
+    
+    // Swap in the textures which finished loading in the background
+    TextureLoader::get().update();
+    
+    if (!m_loaded) {
+        updateLoading();
+        return;
+    }
+    
     // Poll for events
     glfwPollEvents();
     handleRepeatInput();
     
+    // Pick the resolution of the water's render targets based on how long the last frame took
+    m_resolution.setEnabled(m_dynamicResolution);
+    m_resolution.setTargetFPS(m_targetFPS);
+    float scale = m_resolution.update(ImGui::GetIO().DeltaTime);
+    if (scale != m_scene->waterScale()) m_scene->setWaterScale(scale);
+    
     m_scene->character()->glide();
  
     // Update fish positions
@@ -170,7 +274,7 @@ void FishingGame::appLogic()
         if (fish->collision(m_scene->character())) {
             m_scene->removeFish(fish->id());
             m_currScore++;
-            m_scene->currScore()->setImage("Numbers/" + to_string(m_currScore) + ".png");
+            m_scene->hud()->setScore(m_currScore);
         }
     }
 }
@@ -181,6 +285,21 @@ void FishingGame::appLogic()
  */
 void FishingGame::guiLogic()
 {
+    if (!m_loaded) {
+        ImGuiWindowFlags windowFlags(ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoTitleBar |
+                                     ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoInputs);
+        // Just under the progress bar (see drawLoadingScreen)
+        ImVec2 display = ImGui::GetIO().DisplaySize;
+        ImGui::SetNextWindowPos(ImVec2(display.x / 4.0f, display.y / 2.0f + 16.0f));
+        ImGui::Begin("Loading", nullptr, ImVec2(200, 0), 0.0f, windowFlags);
+        if (!m_loading.done())
+            ImGui::Text("Loading... %3.0f%% (%s)", m_loading.progress() * 100.0f, m_loading.status().c_str());
+        else
+            ImGui::Text("Loading textures... (%d left)", TextureLoader::get().pending());
+        ImGui::End();
+        return;
+    }
+    
     static bool firstRun(true);
     if (firstRun) {
         ImGui::SetNextWindowPos(ImVec2(50, 50));
@@ -199,6 +318,9 @@ void FishingGame::guiLogic()
         
             ImGui::Checkbox("Render bounding boxes", &m_renderBoundingBoxes);
             m_scene->renderBoundingBoxes(m_renderBoundingBoxes);
+            
+            ImGui::Checkbox("Render shadow cascades", &m_renderShadowCascades);
+            m_scene->renderShadowCascades(m_renderShadowCascades);
         
             ImGui::Checkbox("Third person view", &m_thirdPersonView);
             m_scene->camera()->setThirdPersonView(m_thirdPersonView);
@@ -212,6 +334,12 @@ void FishingGame::guiLogic()
             ImGui::SliderFloat("Speed of Time", &m_skyboxRotationSpeed, 0.0f, 10.0f, "%.2f");
             m_scene->skybox()->setRotationSpeed(m_skyboxRotationSpeed);
         
+            ImGui::SliderFloat("Terrain Detail Error (px)", &m_terrainLodError, 0.5f, 16.0f, "%.1f");
+            m_scene->terrain()->setLodTolerance(m_terrainLodError);
+        
+            ImGui::Checkbox("Dynamic water resolution", &m_dynamicResolution);
+            ImGui::SliderFloat("Target FPS", &m_targetFPS, 30.0f, 144.0f, "%.0f");
+        
             ImGui::Text("Water rendering mode:");
             ImGui::PushID( 0 );
             if( ImGui::RadioButton( "Regular         ", &m_currMode, REGULAR) ) {}
@@ -222,6 +350,26 @@ void FishingGame::guiLogic()
             m_scene->water()->setMode((Mode) m_currMode);
         
             ImGui::Text( "Framerate: %.1f FPS", ImGui::GetIO().Framerate );
+            ImGui::Text( "Water targets: %dx%d (%.0f%% scale)",
+                         m_scene->waterWidth(), m_scene->waterHeight(), m_scene->waterScale() * 100.0f );
+            ImGui::Text( "Draw calls: %d, program switches: %d",
+                         m_scene->queue()->drawCalls(), m_scene->queue()->programSwitches() );
+            ImGui::Text( "Frustum culling: %d drawn, %d culled",
+                         m_scene->queue()->visibleObjects(), m_scene->queue()->culledObjects() );
+            ImGui::Text( "Terrain: %d chunks, %d triangles",
+                         m_scene->terrain()->chunksDrawn(), m_scene->terrain()->trianglesDrawn() );
+            ImGui::Text( "GPU time (ms): shadows %.2f, refraction %.2f, reflection %.2f, main %.2f",
+                         m_scene->passTime(SHADOW_MAP), m_scene->passTime(REFRACTION),
+                         m_scene->passTime(REFLECTION), m_scene->passTime(REGULAR) );
+            ImGui::Text( "Static shadows: last re-rendered %d frames ago (%s)",
+                         m_scene->framesSinceShadowInvalidation(),
+                         Scene::shadowInvalidationName(m_scene->lastShadowInvalidation()) );
+            ImGui::Text( "  scene changed: %d, sun moved: %d, cascade moved: %d",
+                         m_scene->shadowInvalidations(SHADOWS_SCENE_CHANGED),
+                         m_scene->shadowInvalidations(SHADOWS_SUN_MOVED),
+                         m_scene->shadowInvalidations(SHADOWS_CASCADE_MOVED) );
+            ImGui::Text( "GL state calls: %d issued, %d elided",
+                         GLState::get().issuedCalls(), GLState::get().elidedCalls() );
         
             if ( ImGui::Button( "Reset              (R)" ) ) {
                 m_scene->reset();
@@ -242,6 +390,11 @@ void FishingGame::guiLogic()
  */
 void FishingGame::draw()
 {
+    if (!m_loaded) {
+        drawLoadingScreen();
+        return;
+    }
+    
     m_scene->render();
 }
 
@@ -251,7 +404,10 @@ void FishingGame::draw()
  */
 void FishingGame::cleanup()
 {
-    for (ShaderProgram* shader : m_shaders)
+    // The window may get closed while the workers are still loading things into the scene
+    ThreadPool::get().wait();
+    
+    for (Shader* shader : m_shaders)
         delete shader;
 }
 
@@ -263,7 +419,7 @@ bool FishingGame::mouseMoveEvent (double xPos, double yPos)
 {
 	bool eventHandled(false);
     
-    if (m_mouseDown) {
+    if (m_mouseDown && m_loaded) {
         // Adjust pitch based on change in y
         float dy = m_lastMousePos.y - yPos;
         m_scene->camera()->changePitch(dy * 0.3);
@@ -318,6 +474,7 @@ bool FishingGame::keyInputEvent (int key, int action, int mods)
                 break;
                 
             case GLFW_KEY_R:
+                if (!m_loaded) break;
                 m_scene->reset();
                 m_currScore = 0;
                 eventHandled = true;
@@ -330,6 +487,21 @@ bool FishingGame::keyInputEvent (int key, int action, int mods)
     return eventHandled;
 }
 
+//----------------------------------------------------------------------------------------
+/*
+ * Event handler.  Handles window resize events.
+ */
+bool FishingGame::windowResizeEvent(int, int)
+{
+    // We're given the size of the window in screen coordinates, which isn't the same as its size in
+    // pixels on HiDPI displays
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(m_window, &framebufferWidth, &framebufferHeight);
+    m_scene->resize(framebufferWidth, framebufferHeight);
+    
+    return true;
+}
+
 //----------------------------------------------------------------------------------------
 /*
  * Event handler.  Handles mouse scroll events.
@@ -337,7 +509,7 @@ bool FishingGame::keyInputEvent (int key, int action, int mods)
 
 bool FishingGame::mouseScrollEvent(double xOffSet, double yOffSet) {
     bool eventHandled(true);
-    m_scene->camera()->zoom(yOffSet);
+    if (m_loaded) m_scene->camera()->zoom(yOffSet);
     return eventHandled;
 }
 
@@ -6,12 +6,14 @@
 #include "cs488-framework/OpenGLImport.hpp"
 #include "Scene.hpp"
 #include "Mode.hpp"
+#include "DynamicResolution.hpp"
+#include "LoadingPipeline.hpp"
 
 #include <glm/glm.hpp>
 
 class FishingGame : public CS488Window {
     Scene* m_scene;
-    std::vector<ShaderProgram*> m_shaders;
+    std::vector<Shader*> m_shaders;
     
     // Mouse state
     glm::vec2 m_lastMousePos;
@@ -21,16 +23,29 @@ class FishingGame : public CS488Window {
     bool m_showSettings;
     bool m_thirdPersonView;
     bool m_renderBoundingBoxes;
+    bool m_renderShadowCascades;
     int m_currMode;
     float m_waterDistortion;
     bool m_bumpMapping;
     float m_skyboxRotationSpeed;
+    float m_terrainLodError;    // in pixels
+    bool m_dynamicResolution;
+    float m_targetFPS;
+    
+    // Adjusts the resolution of the water's render targets to hold m_targetFPS
+    DynamicResolution m_resolution;
     
     // Game information
     int m_currScore;
     
+    // Loads everything but the shaders, while the loading screen is up
+    LoadingPipeline m_loading;
+    bool m_loaded;
+    
     // Helpers
-    ShaderProgram* generateShader(std::string vtxShader, std::string fragShader);
+    Shader* generateShader(std::string vtxShader, std::string fragShader, std::string geomShader = "");
+    void updateLoading();
+    void drawLoadingScreen();
     void handleRepeatInput();
     
 public:
@@ -48,4 +63,5 @@ protected:
     virtual bool mouseScrollEvent(double xOffSet, double yOffSet) override;
 	virtual bool mouseButtonInputEvent(int button, int actions, int mods) override;
 	virtual bool keyInputEvent(int key, int action, int mods) override;
+	virtual bool windowResizeEvent(int width, int height) override;
 };
@@ -1,77 +1,157 @@
 #include "FrameBuffer.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <iostream>
 
-FrameBuffer::FrameBuffer(int w, int h, bool drawcolor) : m_texture(0), m_depthTexture(0), m_depthRenderBuffer(0), m_width(w), m_height(h)
+FrameBuffer::FrameBuffer(FrameBufferFormat format, float scale) : m_fbo(0), m_texture(0), m_depthTexture(0),
+    m_depthRenderBuffer(0), m_format(format), m_width(0), m_height(0), m_scale(scale), m_fixedSize(0),
+    m_windowWidth(0), m_windowHeight(0)
+{
+    glGenFramebuffers(1, &m_fbo);
+}
+
+FrameBuffer::FrameBuffer(FrameBufferFormat format, int fixedSize) : m_fbo(0), m_texture(0), m_depthTexture(0),
+    m_depthRenderBuffer(0), m_format(format), m_width(0), m_height(0), m_scale(1.0f), m_fixedSize(fixedSize),
+    m_windowWidth(0), m_windowHeight(0)
 {
     glGenFramebuffers(1, &m_fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
-    if (drawcolor)  glDrawBuffer(GL_COLOR_ATTACHMENT0);
-    else            glDrawBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    CHECK_GL_ERRORS;
 }
 
 FrameBuffer::~FrameBuffer()
 {
+    release();
     glDeleteFramebuffers(1, &m_fbo);
-    glDeleteTextures(1, &m_texture);
-    glDeleteTextures(1, &m_depthTexture);
-    glDeleteRenderbuffers(1, &m_depthRenderBuffer);
     
     CHECK_GL_ERRORS;
 }
 
 void FrameBuffer::bind()
 {
-    glBindTexture(GL_TEXTURE_2D, 0); // ensure texture isn't bound
+    // Ensure our textures aren't bound while we render to them
+    GLState::get().unbindTexture(m_texture);
+    GLState::get().unbindTexture(m_depthTexture, depthTarget());
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
-    
-    // Could change resolution of buffer here
-    // Not doing this because reflection/refraction modes look best at full resolution
-    // glViewport(0, 0, m_width, m_height);
+    glViewport(0, 0, m_width, m_height);
 }
 
 void FrameBuffer::unbind()
 {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    
-    // glViewport(0, 0, display m_width, display m_height);
+    glViewport(0, 0, m_windowWidth, m_windowHeight);
+}
+
+void FrameBuffer::clearDepthLayer(int layer)
+{
+    // Clearing a layered attachment clears every layer, so attach just the one layer for a moment
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, layer);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
 }
 
-void FrameBuffer::addTextureAttachment()
+void FrameBuffer::copyDepthLayer(FrameBuffer& source, int layer)
 {
-    glGenTextures(1, &m_texture);
-    glBindTexture(GL_TEXTURE_2D, m_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width, m_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_texture, 0);
+    // Blits only work on single layers as well
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source.m_fbo);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, source.m_depthTexture, 0, layer);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, layer);
+    
+    glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    
+    glFramebufferTexture(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, source.m_depthTexture, 0);
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
     
     CHECK_GL_ERRORS;
 }
 
-void FrameBuffer::addDepthTextureAttachment()
+void FrameBuffer::resize(int windowWidth, int windowHeight)
 {
-    glGenTextures(1, &m_depthTexture);
-    glBindTexture(GL_TEXTURE_2D, m_depthTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+    m_windowWidth = windowWidth;
+    m_windowHeight = windowHeight;
     
-    CHECK_GL_ERRORS;
+    int width = m_fixedSize ? m_fixedSize : std::max(1, (int) (windowWidth * m_scale));
+    int height = m_fixedSize ? m_fixedSize : std::max(1, (int) (windowHeight * m_scale));
+    if (width == m_width && height == m_height) return;
+    
+    m_width = width;
+    m_height = height;
+    release();
+    allocate();
+}
+
+void FrameBuffer::setScale(float scale)
+{
+    m_scale = scale;
+    resize(m_windowWidth, m_windowHeight);
 }
 
-void FrameBuffer::addDepthRenderBuffer()
+// Creates the attachments at the current size
+void FrameBuffer::allocate()
 {
-    glGenRenderbuffers(1, &m_depthRenderBuffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, m_width, m_height);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    
+    if (m_format.color != GL_NONE) {
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, m_format.color, m_width, m_height, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_texture, 0);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    } else {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    
+    if (m_format.depthTexture) {
+        GLenum target = depthTarget();
+        glGenTextures(1, &m_depthTexture);
+        glBindTexture(target, m_depthTexture);
+        if (target == GL_TEXTURE_2D_ARRAY)
+            glTexImage3D(target, 0, m_format.depth, m_width, m_height, m_format.layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        else
+            glTexImage2D(target, 0, m_format.depth, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        
+        // Note: attaching the whole array makes it a layered attachment
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
+    } else {
+        glGenRenderbuffers(1, &m_depthRenderBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, m_format.depth, m_width, m_height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderBuffer);
+    }
+    
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Framebuffer of size " << m_width << "x" << m_height << " is incomplete" << std::endl;
+    
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    // We bound textures behind the state tracker's back
+    GLState::get().invalidate();
     
     CHECK_GL_ERRORS;
 }
 
+void FrameBuffer::release()
+{
+    // Make sure no stale IDs linger in the state tracker (the driver can hand them out again)
+    GLState::get().unbindTexture(m_texture);
+    GLState::get().unbindTexture(m_depthTexture, depthTarget());
+    
+    glDeleteTextures(1, &m_texture);
+    glDeleteTextures(1, &m_depthTexture);
+    glDeleteRenderbuffers(1, &m_depthRenderBuffer);
+    m_texture = 0;
+    m_depthTexture = 0;
+    m_depthRenderBuffer = 0;
+}
+
 GLuint FrameBuffer::texture()
 {
     return m_texture;
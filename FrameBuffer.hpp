@@ -9,26 +9,58 @@
 #include <glm/gtx/io.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// Which attachments a framebuffer has & what format they are stored in
+struct FrameBufferFormat {
+    GLenum color;           // internal format of the color texture, or GL_NONE for depth-only buffers
+    GLenum depth;           // internal format of the depth attachment
+    bool depthTexture;      // whether the depth can be sampled afterwards (otherwise it's a render buffer)
+    int layers;             // > 1 for a depth texture array, which gets rendered to with gl_Layer
+};
+
+/*
+ An offscreen render target. Its size is either a fraction of the window's (ie. half resolution
+ reflections) or fixed (ie. a 2048x2048 shadow map), & its attachments are (re)allocated whenever
+ that size changes - so the window size must be passed along every time it changes.
+ */
 class FrameBuffer {
     GLuint m_fbo;
     GLuint m_texture;
     GLuint m_depthTexture;
     GLuint m_depthRenderBuffer;
+    FrameBufferFormat m_format;
+    
     int m_width;
     int m_height;
+    float m_scale;          // size relative to the window, if m_fixedSize is 0
+    int m_fixedSize;
+    
+    // Size of the default framebuffer, which gets restored when we unbind
+    int m_windowWidth;
+    int m_windowHeight;
+    
+    void allocate();
+    void release();
     
 public:
-    FrameBuffer(int w, int h, bool drawcolor);
+    FrameBuffer(FrameBufferFormat format, float scale);     // scale = fraction of the window size
+    FrameBuffer(FrameBufferFormat format, int fixedSize);   // fixed, square size (in pixels)
     ~FrameBuffer();
     
-    void bind();
-    void unbind();
+    void bind();        // also sets the viewport to the size of the framebuffer
+    void unbind();      // restores the window's viewport
+    
+    // Layered framebuffers only: clear or copy 1 layer of the depth texture array (must be bound)
+    void clearDepthLayer(int layer);
+    void copyDepthLayer(FrameBuffer& source, int layer);    // source must have the same size & format
     
-    void addTextureAttachment();
-    void addDepthTextureAttachment();
-    void addDepthRenderBuffer();
+    void resize(int windowWidth, int windowHeight);
+    void setScale(float scale);
     
     // Accessors
     GLuint texture();
     GLuint depthTexture();
+    GLenum depthTarget()    { return m_format.layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D; };
+    int width()     { return m_width; };
+    int height()    { return m_height; };
+    float scale()   { return m_scale; };
 };
@@ -0,0 +1,151 @@
+#include "FrameContext.hpp"
+#include "Scene.hpp"
+#include "GLState.hpp"
+#include <cstring>
+
+using namespace std;
+using namespace glm;
+
+static const int OBJECT_SLOTS = 4096; // draw calls per buffer before it gets orphaned & reused
+
+FrameContext::FrameContext(Scene* scene) : m_scene(scene), m_objectOffset(0), m_mode(REGULAR), m_lodScale(1.0f)
+{
+    // Frame & pass data each live in their own small buffer which is bound once, for good
+    glGenBuffers(1, &m_frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK, m_frameUBO);
+
+    glGenBuffers(1, &m_passUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_passUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(PassUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, PASS_BLOCK, m_passUBO);
+
+    // Every slot of the object buffer must start at a multiple of the driver's offset alignment
+    GLint alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_objectSlotSize = ((sizeof(ObjectUniforms) + alignment - 1) / alignment) * alignment;
+    m_objectBufferSize = m_objectSlotSize * OBJECT_SLOTS;
+
+    glGenBuffers(1, &m_objectUBO);
+    orphanObjectBuffer();
+
+    CHECK_GL_ERRORS;
+}
+
+FrameContext::~FrameContext()
+{
+    glDeleteBuffers(1, &m_frameUBO);
+    glDeleteBuffers(1, &m_passUBO);
+    glDeleteBuffers(1, &m_objectUBO);
+}
+
+// Gives the object buffer fresh storage, so that we can keep writing to it without waiting for
+// the GPU to finish with draw calls which still reference the old contents
+void FrameContext::orphanObjectBuffer()
+{
+    GLState::get().bindBuffer(GL_UNIFORM_BUFFER, m_objectUBO);
+    glBufferData(GL_UNIFORM_BUFFER, m_objectBufferSize, NULL, GL_STREAM_DRAW);
+    m_objectOffset = 0;
+}
+
+void FrameContext::beginFrame()
+{
+    // Everything which depends only on the sun is the same for the entire frame
+    // Note: the shadow cascades are fit to the camera's view, so it must not be flipped for the water
+    ShadowCascades* cascades = m_scene->cascades();
+    cascades->update(m_scene->camera(), m_scene->sun()->directionToSun());
+    
+    // The shadow pass renders every cascade at once, so its frustum covers all of them
+    m_sunView = cascades->lightView();
+    m_sunProj = cascades->coverProjection();
+
+    m_frame.lightColor = vec4(m_scene->sun()->color(), 1.0f);
+    m_frame.lightPosition = vec4(m_scene->sun()->position(), 1.0f);
+    m_frame.ambientIntensity = vec4(vec3(0.5f), 0.0f);
+    for (int i=0; i<cascades->count(); i++) {
+        m_frame.toShadowMapSpace[i] = cascades->viewProjection(i);
+        m_frame.cascadeSplits[i] = cascades->splitDistance(i);
+    }
+    m_frame.cascadeCount = ivec4(cascades->count());
+
+    GLState::get().bindBuffer(GL_UNIFORM_BUFFER, m_frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &m_frame);
+
+    orphanObjectBuffer();
+
+    CHECK_GL_ERRORS;
+}
+
+void FrameContext::beginPass(Mode mode, int targetHeight)
+{
+    m_mode = mode;
+
+    if (mode == SHADOW_MAP) {
+        // The shadow map is rendered from the sun's perspective
+        m_pass.view = m_sunView;
+        m_pass.projection = m_sunProj;
+        m_pass.cameraPosition = m_frame.lightPosition;
+    } else {
+        m_pass.view = m_scene->camera()->viewMatrix();
+        m_pass.projection = m_scene->camera()->projMatrix();
+        m_pass.cameraPosition = vec4(m_scene->camera()->position(), 1.0f);
+    }
+
+    // Each pass culls against its own frustum: the camera's, the mirrored camera's or the sun's
+    m_frustum = Frustum(m_pass.projection * m_pass.view);
+    
+    // Used for level of detail selection, which is based on how many pixels a given error covers
+    // Note: the height is passed in rather than read back from the viewport, since the pass' target
+    //       isn't necessarily bound yet (ie. the shadow map's)
+    m_lodScale = 0.5f * (float) targetHeight * m_pass.projection[1][1];
+    
+    // Define a clipping plane in the form (A, B, C, D) where A, B, C is the normal & D is the distance from the origin
+    m_pass.clippingEnabled = ivec4(mode == REFLECTION || mode == REFRACTION);
+    if (mode == REFLECTION)
+        // Clip everything below water level
+        m_pass.clippingPlane = vec4(0, 1, 0, m_scene->water()->position().y);
+
+    else if (mode == REFRACTION)
+        // Clip everything above water level + 1 (offset is to fix water displacement problem)
+        m_pass.clippingPlane = vec4(0, -1, 0, m_scene->water()->position().y + 1.0f);
+
+    else
+        m_pass.clippingPlane = vec4(0.0f);
+
+    GLState::get().bindBuffer(GL_UNIFORM_BUFFER, m_passUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PassUniforms), &m_pass);
+
+    CHECK_GL_ERRORS;
+}
+
+GLintptr FrameContext::writeObjects(const ObjectUniforms* data, int count)
+{
+    GLsizeiptr size = count * m_objectSlotSize;
+    if (size > m_objectBufferSize) {
+        // Grow the buffer so that a whole pass always fits
+        while (m_objectBufferSize < size) m_objectBufferSize *= 2;
+        orphanObjectBuffer();
+    }
+    else if (m_objectOffset + size > m_objectBufferSize) {
+        orphanObjectBuffer();
+    }
+
+    m_staging.resize(size);
+    for (int i=0; i<count; i++)
+        memcpy(&m_staging[i * m_objectSlotSize], &data[i], sizeof(ObjectUniforms));
+
+    GLintptr offset = m_objectOffset;
+    GLState::get().bindBuffer(GL_UNIFORM_BUFFER, m_objectUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, m_staging.data());
+
+    m_objectOffset += size;
+
+    CHECK_GL_ERRORS;
+    return offset;
+}
+
+void FrameContext::bindObjectAt(GLintptr offset)
+{
+    GLState::get().bindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK, m_objectUBO, offset, sizeof(ObjectUniforms));
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "Shader.hpp"
+#include "Mode.hpp"
+#include "Frustum.hpp"
+#include "ShadowCascades.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+class Scene;
+
+/*
+ The following structs mirror the std140 uniform blocks declared in our shaders, so they must be
+ kept in sync with the GLSL declarations (note that std140 pads every vec3 to a vec4)
+ */
+
+// Constant for the whole frame
+struct FrameUniforms {
+    glm::vec4 lightColor;
+    glm::vec4 lightPosition;
+    glm::vec4 ambientIntensity;
+    glm::mat4 toShadowMapSpace[ShadowCascades::MAX_CASCADES];
+    glm::vec4 cascadeSplits;        // distance from the camera at which each cascade ends
+    glm::ivec4 cascadeCount;        // only x is used
+};
+
+// Constant for each pass (regular, reflection, refraction & shadow map)
+struct PassUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 cameraPosition;
+    glm::vec4 clippingPlane;
+    glm::ivec4 clippingEnabled;     // only x is used
+};
+
+// Different for every draw call
+struct ObjectUniforms {
+    glm::mat4 model;
+    glm::vec4 materialKd;
+    glm::vec4 materialKs;           // w = shininess
+    glm::ivec4 flags;               // x = is terrain object, y = is mesh object, z = is instanced, w = has no texture coordinates
+    glm::vec4 dequantScale;         // maps packed vertices back to model space (see Quantization)
+    glm::vec4 dequantOffset;
+
+    ObjectUniforms() : model(1.0f), materialKd(0.0f), materialKs(0.0f), flags(0),
+                       dequantScale(1.0f), dequantOffset(0.0f) {};
+};
+
+// Computes the frame & pass state once & publishes it to every shader through uniform buffer
+// objects, so that individual objects only need to upload the data which is specific to them
+class FrameContext {
+    Scene* m_scene;
+
+    GLuint m_frameUBO;
+    GLuint m_passUBO;
+
+    // Per-object data is written into consecutive slots of one large buffer, & each draw call
+    // binds its own slot with glBindBufferRange
+    GLuint m_objectUBO;
+    GLsizeiptr m_objectSlotSize;    // sizeof(ObjectUniforms) rounded up to the offset alignment
+    GLsizeiptr m_objectBufferSize;
+    GLintptr m_objectOffset;
+    std::vector<unsigned char> m_staging;   // object data spaced out by the slot size
+
+    Mode m_mode;
+    FrameUniforms m_frame;
+    PassUniforms m_pass;
+    Frustum m_frustum;              // of the current pass' view & projection matrices
+    float m_lodScale;               // pixels covered by 1 world unit at a distance of 1 in the current pass
+    glm::mat4 m_sunView;
+    glm::mat4 m_sunProj;
+
+    void orphanObjectBuffer();
+
+public:
+    FrameContext(Scene* scene);
+    ~FrameContext();
+
+    void beginFrame();              // requires the camera's position to be up to date
+
+    // Requires the camera to already be set up for that pass - targetHeight is the height (in pixels)
+    // of the framebuffer which the pass renders into
+    void beginPass(Mode m, int targetHeight);
+    
+    // Uploads the per-object data for many draw calls at once & returns the offset of the first
+    // one - draw i can then be bound with bindObjectAt(offset + i * slot size)
+    GLintptr writeObjects(const ObjectUniforms* data, int count);
+    void bindObjectAt(GLintptr offset);
+    GLsizeiptr objectSlotSize()     { return m_objectSlotSize; };
+
+    // Accessors
+    Mode mode()                     { return m_mode; };
+    const PassUniforms& pass()      { return m_pass; };
+    const Frustum& frustum()        { return m_frustum; };
+    float lodScale()                { return m_lodScale; };
+    glm::mat4 sunViewMatrix()       { return m_sunView; };
+    glm::mat4 sunProjMatrix()       { return m_sunProj; };
+};
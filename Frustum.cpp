@@ -0,0 +1,101 @@
+#include "Frustum.hpp"
+#include <cmath>
+
+#ifdef FRUSTUM_USE_SSE
+    #include <xmmintrin.h>
+#endif
+
+using namespace std;
+using namespace glm;
+
+AABB AABB::transform(const mat4& model, vec3 min, vec3 max)
+{
+    // Transform the center, then find the extent along each world axis of the rotated/scaled box
+    vec3 center = (min + max) * 0.5f;
+    vec3 extent = (max - min) * 0.5f;
+    
+    vec3 worldCenter = vec3(model * vec4(center, 1.0f));
+    mat3 absolute = mat3(glm::abs(vec3(model[0])), glm::abs(vec3(model[1])), glm::abs(vec3(model[2])));
+    vec3 worldExtent = absolute * extent;
+    
+    return AABB(worldCenter - worldExtent, worldCenter + worldExtent);
+}
+
+void AABB::expand(const AABB& other)
+{
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+Frustum::Frustum()
+{
+    // Accepts everything
+    for (int i=0; i<8; i++) { m_x[i] = 0.0f; m_y[i] = 0.0f; m_z[i] = 0.0f; m_w[i] = 1.0f; }
+}
+
+Frustum::Frustum(const mat4& viewProj)
+{
+    // Extract the planes from the rows of the view-projection matrix (Gribb & Hartmann)
+    // Note: glm matrices are column major, so m[col][row]
+    vec4 rows[4];
+    for (int i=0; i<4; i++) rows[i] = vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    
+    vec4 planes[6] = {
+        rows[3] + rows[0],  // left
+        rows[3] - rows[0],  // right
+        rows[3] + rows[1],  // bottom
+        rows[3] - rows[1],  // top
+        rows[3] + rows[2],  // near
+        rows[3] - rows[2],  // far
+    };
+    
+    for (int i=0; i<8; i++) {
+        // Pad with copies of the last plane so that they don't change the result
+        vec4 p = planes[i < 6 ? i : 5];
+        m_x[i] = p.x; m_y[i] = p.y; m_z[i] = p.z; m_w[i] = p.w;
+    }
+}
+
+/*
+ A box is outside of the frustum if it is entirely on the negative side of any one plane. For a plane
+ with normal n, the point of the box furthest along n is at a distance of dot(n, center) + w +
+ dot(abs(n), extent) - if even that is negative, the whole box is behind the plane.
+ */
+bool Frustum::intersects(const AABB& box) const
+{
+    vec3 center = (box.min + box.max) * 0.5f;
+    vec3 extent = (box.max - box.min) * 0.5f;
+    
+#ifdef FRUSTUM_USE_SSE
+    const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    
+    for (int i=0; i<8; i+=4) {
+        __m128 px = _mm_load_ps(m_x + i);
+        __m128 py = _mm_load_ps(m_y + i);
+        __m128 pz = _mm_load_ps(m_z + i);
+        __m128 pw = _mm_load_ps(m_w + i);
+        
+        // dot(n, center) + w
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+                                 _mm_add_ps(_mm_mul_ps(pz, cz), pw));
+        
+        // dot(abs(n), extent)
+        __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+                                              _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+                                   _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+        
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps())) != 0)
+            return false;
+    }
+    return true;
+#else
+    for (int i=0; i<6; i++) {
+        float dist = m_x[i] * center.x + m_y[i] * center.y + m_z[i] * center.z + m_w[i];
+        float radius = fabsf(m_x[i]) * extent.x + fabsf(m_y[i]) * extent.y + fabsf(m_z[i]) * extent.z;
+        if (dist + radius < 0.0f) return false;
+    }
+    return true;
+#endif
+}
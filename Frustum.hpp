@@ -0,0 +1,40 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include <glm/glm.hpp>
+
+// SSE is available on every x86-64 CPU - other platforms (ie. ARM Macs) use the scalar version
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define FRUSTUM_USE_SSE
+#endif
+
+// Axis aligned bounding box
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+    
+    AABB() : min(0.0f), max(0.0f) {};
+    AABB(glm::vec3 mn, glm::vec3 mx) : min(mn), max(mx) {};
+    
+    // Bounding box (in world space) of a box in model space after it has been transformed by the model matrix
+    static AABB transform(const glm::mat4& model, glm::vec3 min, glm::vec3 max);
+    
+    void expand(const AABB& other);
+};
+
+// The 6 planes of the volume visible through a view & projection matrix
+class Frustum {
+    // Stored as a structure of arrays (padded to 8 planes) so that 4 planes can be tested at once
+    alignas(16) float m_x[8];
+    alignas(16) float m_y[8];
+    alignas(16) float m_z[8];
+    alignas(16) float m_w[8];
+    
+public:
+    Frustum();
+    Frustum(const glm::mat4& viewProj);
+    
+    // Conservative test: may report boxes which are just outside of a corner of the frustum as visible
+    bool intersects(const AABB& box) const;
+};
@@ -0,0 +1,168 @@
+#include "GLState.hpp"
+#include <cassert>
+
+using namespace std;
+
+GLState::GLState() : m_issued(0), m_elided(0), m_lastIssued(0), m_lastElided(0)
+{
+    invalidate();
+}
+
+GLState& GLState::get()
+{
+    static GLState state;
+    return state;
+}
+
+void GLState::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vao = UNKNOWN;
+    m_arrayBuffer = UNKNOWN;
+    m_uniformBuffer = UNKNOWN;
+    for (auto& range : m_uniformRanges) range.buffer = UNKNOWN;
+    
+    m_activeUnit = UNKNOWN;
+    for (auto& unit : m_textures) unit.id = UNKNOWN;
+    
+    m_blend = UNKNOWN_FLAG;
+    m_blendSrc = UNKNOWN;
+    m_blendDst = UNKNOWN;
+    m_depthTest = UNKNOWN_FLAG;
+    m_depthMask = UNKNOWN_FLAG;
+    for (auto& clip : m_clipDistances) clip = UNKNOWN_FLAG;
+}
+
+void GLState::beginFrame()
+{
+    // ImGui & anything else which ran since the last frame may have changed the state
+    invalidate();
+    
+    m_lastIssued = m_issued;
+    m_lastElided = m_elided;
+    m_issued = 0;
+    m_elided = 0;
+}
+
+bool GLState::elide(bool unchanged)
+{
+    if (unchanged)  m_elided++;
+    else            m_issued++;
+    return unchanged;
+}
+
+// Setters ---------------------------------------------------------------------------------
+
+void GLState::useProgram(GLuint program)
+{
+    if (elide(program == m_program)) return;
+    glUseProgram(program);
+    m_program = program;
+}
+
+void GLState::bindVertexArray(GLuint vao)
+{
+    if (elide(vao == m_vao)) return;
+    glBindVertexArray(vao);
+    m_vao = vao;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+    // Note: the element array buffer is part of the VAO's state, so it always goes through
+    GLuint* current = nullptr;
+    if (target == GL_ARRAY_BUFFER)          current = &m_arrayBuffer;
+    else if (target == GL_UNIFORM_BUFFER)   current = &m_uniformBuffer;
+    
+    if (current && elide(buffer == *current)) return;
+    if (!current) m_issued++;
+    
+    glBindBuffer(target, buffer);
+    if (current) *current = buffer;
+}
+
+void GLState::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    assert(target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BUFFERS);
+    BufferRange& range = m_uniformRanges[index];
+    if (elide(range.buffer == buffer && range.offset == offset && range.size == size)) return;
+    
+    glBindBufferRange(target, index, buffer, offset, size);
+    range.buffer = buffer;
+    range.offset = offset;
+    range.size = size;
+    
+    // glBindBufferRange also binds the buffer to the generic binding point
+    m_uniformBuffer = buffer;
+}
+
+void GLState::activeTexture(int unit)
+{
+    GLenum texture = GL_TEXTURE0 + unit;
+    if (elide(m_activeUnit == texture)) return;
+    glActiveTexture(texture);
+    m_activeUnit = texture;
+}
+
+void GLState::bindTexture(int unit, GLenum target, GLuint texture)
+{
+    assert(unit < MAX_TEXTURE_UNITS);
+    TextureUnit& current = m_textures[unit];
+    if (elide(current.target == target && current.id == texture)) return;
+    
+    activeTexture(unit);
+    glBindTexture(target, texture);
+    current.target = target;
+    current.id = texture;
+}
+
+void GLState::unbindTexture(GLuint texture, GLenum target)
+{
+    if (texture == 0) return;
+    
+    for (int unit=0; unit<MAX_TEXTURE_UNITS; unit++) {
+        // A unit we know nothing about could be holding the texture, so it has to be cleared too
+        if (m_textures[unit].id == texture || m_textures[unit].id == UNKNOWN)
+            bindTexture(unit, target, 0);
+    }
+}
+
+void GLState::setBlend(bool enabled)
+{
+    if (elide(m_blend == (int) enabled)) return;
+    if (enabled)    glEnable(GL_BLEND);
+    else            glDisable(GL_BLEND);
+    m_blend = enabled;
+}
+
+void GLState::blendFunc(GLenum src, GLenum dst)
+{
+    if (elide(m_blendSrc == src && m_blendDst == dst)) return;
+    glBlendFunc(src, dst);
+    m_blendSrc = src;
+    m_blendDst = dst;
+}
+
+void GLState::setDepthTest(bool enabled)
+{
+    if (elide(m_depthTest == (int) enabled)) return;
+    if (enabled)    glEnable(GL_DEPTH_TEST);
+    else            glDisable(GL_DEPTH_TEST);
+    m_depthTest = enabled;
+}
+
+void GLState::depthMask(bool enabled)
+{
+    if (elide(m_depthMask == (int) enabled)) return;
+    glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+    m_depthMask = enabled;
+}
+
+void GLState::setClipDistance(int i, bool enabled)
+{
+    assert(i < MAX_CLIP_DISTANCES);
+    if (elide(m_clipDistances[i] == (int) enabled)) return;
+    if (enabled)    glEnable(GL_CLIP_DISTANCE0 + i);
+    else            glDisable(GL_CLIP_DISTANCE0 + i);
+    m_clipDistances[i] = enabled;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/OpenGLImport.hpp"
+
+// Shadows the bits of OpenGL state that our rendering code changes every draw call, so that calls which
+// wouldn't change anything never reach the driver
+// Note: anything that changes GL state behind our back (ImGui, object constructors) must be followed by
+//       a call to invalidate(), which forces the next call of every kind to go through
+class GLState {
+public:
+    static const int MAX_TEXTURE_UNITS = 8;
+    static const int MAX_UNIFORM_BUFFERS = 4;
+    static const int MAX_CLIP_DISTANCES = 1;
+    
+private:
+    static const GLuint UNKNOWN = ~0u;
+    static const int UNKNOWN_FLAG = -1;
+    
+    struct TextureUnit {
+        GLenum target;
+        GLuint id;
+    };
+    
+    struct BufferRange {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+    
+    GLuint m_program;
+    GLuint m_vao;
+    GLuint m_arrayBuffer;
+    GLuint m_uniformBuffer;
+    BufferRange m_uniformRanges[MAX_UNIFORM_BUFFERS];
+    
+    GLenum m_activeUnit;
+    TextureUnit m_textures[MAX_TEXTURE_UNITS];
+    
+    int m_blend;                // -1 = unknown, otherwise enabled or not
+    GLenum m_blendSrc;
+    GLenum m_blendDst;
+    int m_depthTest;
+    int m_depthMask;
+    int m_clipDistances[MAX_CLIP_DISTANCES];
+    
+    // Statistics for the current & the previous frame
+    int m_issued;
+    int m_elided;
+    int m_lastIssued;
+    int m_lastElided;
+    
+    bool elide(bool unchanged);     // updates the counters & returns unchanged
+    void activeTexture(int unit);
+    
+    GLState();
+    
+public:
+    static GLState& get();          // there is only one GL context, so there is only one GLState
+    
+    void invalidate();
+    void beginFrame();              // invalidates everything & starts counting the next frame
+    
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void unbindTexture(GLuint texture, GLenum target = GL_TEXTURE_2D);     // from every unit it is bound to (ie. before rendering to it)
+    
+    void setBlend(bool enabled);
+    void blendFunc(GLenum src, GLenum dst);
+    void setDepthTest(bool enabled);
+    void depthMask(bool enabled);
+    void setClipDistance(int i, bool enabled);
+    
+    // Number of GL calls made & avoided during the previous frame
+    int issuedCalls()   { return m_lastIssued; };
+    int elidedCalls()   { return m_lastElided; };
+};
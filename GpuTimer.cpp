@@ -0,0 +1,57 @@
+#include "GpuTimer.hpp"
+#include "cs488-framework/GlErrorCheck.hpp"
+
+using namespace std;
+
+static const float SMOOTHING = 0.9f;    // weight of the previous average
+
+GpuTimer::GpuTimer() : m_next(0), m_running(false), m_milliseconds(0.0f)
+{
+    glGenQueries(QUERIES, m_queries);
+    for (int i=0; i<QUERIES; i++) m_pending[i] = false;
+}
+
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(QUERIES, m_queries);
+}
+
+void GpuTimer::begin()
+{
+    readQueries();
+
+    // If the GPU is so far behind that the oldest query still isn't done, skip a frame rather than
+    // waiting for it
+    m_running = !m_pending[m_next];
+    if (m_running) glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+}
+
+void GpuTimer::end()
+{
+    if (!m_running) return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    m_pending[m_next] = true;
+    m_next = (m_next + 1) % QUERIES;
+    m_running = false;
+
+    CHECK_GL_ERRORS;
+}
+
+// Picks up the results of every query which the GPU has finished with, oldest first
+void GpuTimer::readQueries()
+{
+    for (int i=0; i<QUERIES; i++) {
+        int q = (m_next + i) % QUERIES;
+        if (!m_pending[q]) continue;
+
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(m_queries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;  // neither are any of the newer ones
+
+        GLuint nanoseconds;
+        glGetQueryObjectuiv(m_queries[q], GL_QUERY_RESULT, &nanoseconds);
+        m_milliseconds = SMOOTHING * m_milliseconds + (1.0f - SMOOTHING) * (float) nanoseconds / 1.0e6f;
+        m_pending[q] = false;
+    }
+}
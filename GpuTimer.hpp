@@ -0,0 +1,34 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/OpenGLImport.hpp"
+
+/*
+ Measures how long the GPU spends on the commands issued between begin() & end(), using
+ GL_TIME_ELAPSED queries. The GPU runs a frame or two behind the CPU, so the results are picked up
+ whenever they're ready rather than waited on - the time returned is the average of the last few
+ frames that finished.
+
+ Note: time elapsed queries can't be nested, so only one timer can be running at once
+ */
+class GpuTimer {
+    static const int QUERIES = 3;   // in flight at once
+
+    GLuint m_queries[QUERIES];
+    bool m_pending[QUERIES];
+    int m_next;
+    bool m_running;                 // whether begin() started a query
+    float m_milliseconds;           // smoothed
+
+    void readQueries();
+
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    void begin();
+    void end();
+
+    float milliseconds()    { return m_milliseconds; };
+};
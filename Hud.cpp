@@ -0,0 +1,28 @@
+#include "Hud.hpp"
+#include "Scene.hpp"
+#include <string>
+
+using namespace std;
+using namespace glm;
+
+Hud::Hud(Scene* scene) : Renderable(), m_scene(scene), m_score(0)
+{
+    SpriteBatch* sprites = m_scene->sprites();
+    for (int i=0; i<=MAX_SCORE; i++)
+        m_numbers[i] = sprites->find("Numbers/" + to_string(i) + ".png");
+    m_slash = sprites->find("Numbers/Slash.png");
+}
+
+void Hud::setScore(int score)
+{
+    m_score = glm::clamp(score, 0, MAX_SCORE);
+}
+
+void Hud::submit(RenderQueue&, Mode)
+{
+    // Note: the positions are in NDC & the sizes are relative to the size of the screen
+    SpriteBatch* sprites = m_scene->sprites();
+    sprites->draw(m_numbers[m_score], vec2(0.75f, 0.9f), vec2(0.065f));     // current score
+    sprites->draw(m_numbers[MAX_SCORE], vec2(0.9f, 0.7f), vec2(0.065f));    // out of
+    sprites->draw(m_slash, vec2(0.825f, 0.8f), vec2(0.05f));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "Renderable.hpp"
+#include "SpriteBatch.hpp"
+
+class Scene;
+
+// The score ("x / 10") in the top right corner of the screen, drawn through the scene's sprite batch
+class Hud : public Renderable {
+    static const int MAX_SCORE = 10;
+    
+    Scene* m_scene;
+    int m_score;
+    
+    // Sprite IDs in the atlas
+    int m_numbers[MAX_SCORE + 1];
+    int m_slash;
+    
+public:
+    Hud(Scene* scene);
+    
+    void setScore(int score);
+    
+    void submit(RenderQueue& queue, Mode mode) final;
+    void submitToShadowMap(RenderQueue&) final {}; // noop
+};
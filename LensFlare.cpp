@@ -9,31 +9,39 @@ using namespace glm;
  comes from https://www.youtube.com/watch?v=OiMRdkhvwqg&list=PLRIWtICgwaX0u7Rf9zkZhLoLuZVfUksDP&index=57
  */
 
-LensFlare::LensFlare(ShaderProgram* shader, Scene* scene) : Renderable(), m_scene(scene)
+LensFlare::LensFlare(Scene* scene) : Renderable(), m_scene(scene)
 {
-    // Initialize the images
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex6.png", vec2(0.5f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex4.png", vec2(0.023f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex2.png", vec2(0.1f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex7.png", vec2(0.05f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex3.png", vec2(0.06f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex5.png", vec2(0.07f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex7.png", vec2(0.2f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex3.png", vec2(0.6f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex5.png", vec2(0.3f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex4.png", vec2(0.4f)));
-    m_images.push_back(new Image2D(shader, m_scene, "LensFlare/tex8.png", vec2(0.6f)));
+    // Initialize the flares (the textures are all part of the sprite atlas)
+    addFlare("LensFlare/tex6.png", 0.5f);
+    addFlare("LensFlare/tex4.png", 0.023f);
+    addFlare("LensFlare/tex2.png", 0.1f);
+    addFlare("LensFlare/tex7.png", 0.05f);
+    addFlare("LensFlare/tex3.png", 0.06f);
+    addFlare("LensFlare/tex5.png", 0.07f);
+    addFlare("LensFlare/tex7.png", 0.2f);
+    addFlare("LensFlare/tex3.png", 0.6f);
+    addFlare("LensFlare/tex5.png", 0.3f);
+    addFlare("LensFlare/tex4.png", 0.4f);
+    addFlare("LensFlare/tex8.png", 0.6f);
 }
 
-LensFlare::~LensFlare()
+void LensFlare::addFlare(const string& path, float size)
 {
-    for (auto img : m_images) delete img;
+    Flare f;
+    f.sprite = m_scene->sprites()->find(path);
+    f.size = size;
+    m_flares.push_back(f);
 }
 
-void LensFlare::render(Mode mode)
+void LensFlare::submit(RenderQueue&, Mode)
 {
     if (m_scene->camera()->isThirdPerson()) return; // don't render in 3rd person mode - this just causes bugs
     
+    // Skip the whole effect while the sun is hidden behind the terrain, trees, rocks, etc
+    // Note: this comes from the sun's occlusion queries, so it lags behind by a frame or two
+    float visibility = m_scene->sun()->visibility();
+    if (visibility <= 0.0f) return;
+    
     /* Step 1) Get the position of the sun in screen coordinates */
     vec4 sunPosition = m_scene->camera()->projMatrix() * m_scene->camera()->viewMatrix() * vec4(m_scene->sun()->position(), 1.0f);
     vec2 sunScreenCoords = vec2(sunPosition.x / sunPosition.w, sunPosition.y / sunPosition.w); // Perspective division
@@ -47,29 +55,15 @@ void LensFlare::render(Mode mode)
     if (brightness <= 0.0f)
         return; // The sun isn't centered enough for us the lens flare effect to be present
     
-    // Need to prevent flare from being rendered when the sun is blocked from view by the terrain
-    // We know the sun drops behind the horizon at time 0.8754 & rises at time 0.122056
-    float timeUntilSunrise = 0.122056f - m_scene->skybox()->time();
-    if (timeUntilSunrise > 0.05f)
-        return;
-    else if (timeUntilSunrise >= 0.0f)
-        brightness *= 1.0f - (timeUntilSunrise * 20.0f); // fade from a brightness of 0 to 1 as the time to sunrise decreases
-    
-    float timeSinceSundown = m_scene->skybox()->time() - 0.8754f;
-    if (timeSinceSundown > 0.05f)
-        return;
-    else if (timeSinceSundown >= 0.0f)
-        brightness *= 1.0f - (timeSinceSundown * 20.0f); // fade from a brightness of 1 to 0 as the time since sundown increases
+    // The flare fades out as more of the sun gets covered up
+    brightness *= visibility;
     
-    /* Step 3) Calculate the positions of each flare texture */
+    /* Step 3) Calculate the positions of each flare texture & hand them to the sprite batch */
+    // Lens flare uses additive blending
     float spacing = 0.4;
-    for (int i=0; i<m_images.size(); i++) {
+    for (int i=0; i<(int) m_flares.size(); i++) {
         vec2 position = sunScreenCoords + i * spacing * sunToCenterOfScreen;
-        m_images[i]->setPosition(vec3(position.x, position.y, 0.0));
-        m_images[i]->setTransparency(brightness);
+        m_scene->sprites()->draw(m_flares[i].sprite, position, vec2(m_flares[i].size), brightness, BLEND_ADDITIVE);
     }
-
-    // Render them
-    for (auto img : m_images) img->render(mode);
 }
 
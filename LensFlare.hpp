@@ -3,17 +3,27 @@
 #define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
 
 #include "Renderable.hpp"
-#include "Object.hpp"
+#include "SpriteBatch.hpp"
+#include <vector>
 
-// This class is a container of Image2D's
+class Scene;
+
+// A series of additively blended sprites lined up between the sun & the center of the screen,
+// drawn through the scene's sprite batch
 class LensFlare : public Renderable {
+    struct Flare {
+        int sprite;     // ID in the sprite atlas
+        float size;
+    };
+    
     Scene* m_scene;
-    std::vector<Image2D*> m_images;
+    std::vector<Flare> m_flares;
+    
+    void addFlare(const std::string& path, float size);
     
 public:
-    LensFlare(ShaderProgram* shader, Scene* scene);
-    ~LensFlare();
+    LensFlare(Scene* scene);
     
-    void render(Mode mode) final;
-    void renderToShadowMap() final {}; // noop
+    void submit(RenderQueue& queue, Mode mode) final;
+    void submitToShadowMap(RenderQueue&) final {}; // noop
 };
@@ -0,0 +1,96 @@
+#include "LoadingPipeline.hpp"
+#include "ThreadPool.hpp"
+#include <cassert>
+#include <cstdio>
+
+using namespace std;
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+LoadingPipeline::Task LoadingPipeline::add(const string& name, function<void()> work, function<void()> upload,
+                                           const vector<Task>& dependencies)
+{
+    Task task = (Task) m_tasks.size();
+
+    TaskInfo info;
+    info.name = name;
+    info.work = work;
+    info.upload = upload;
+    info.waitingOn = (int) dependencies.size();
+    info.workTime = 0.0;
+    for (Task dependency : dependencies) {
+        assert(dependency >= 0 && dependency < task);
+        m_tasks[dependency].dependents.push_back(task);
+    }
+
+    m_tasks.push_back(info);
+    return task;
+}
+
+// Note: no tasks can be added from here on, since the workers hold on to them
+void LoadingPipeline::start()
+{
+    m_startTime = chrono::steady_clock::now();
+    for (Task task=0; task<(Task) m_tasks.size(); task++)
+        if (m_tasks[task].waitingOn == 0) start(task);
+}
+
+void LoadingPipeline::start(Task task)
+{
+    if (!m_tasks[task].work) {
+        worked(task);
+        return;
+    }
+
+    ThreadPool::get().submit([this, task]() {
+        auto begin = chrono::steady_clock::now();
+        m_tasks[task].work();
+        m_tasks[task].workTime = secondsSince(begin);
+        worked(task);
+    });
+}
+
+void LoadingPipeline::worked(Task task)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_worked.push_back(task);
+}
+
+bool LoadingPipeline::update(double budget)
+{
+    auto begin = chrono::steady_clock::now();
+    int uploaded = 0;
+
+    while (!done()) {
+        Task task;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_worked.empty()) break;
+            task = m_worked.front();
+            m_worked.erase(m_worked.begin());
+        }
+
+        TaskInfo& info = m_tasks[task];
+        auto uploadStart = chrono::steady_clock::now();
+        if (info.upload) info.upload();
+        m_busyTime += info.workTime + secondsSince(uploadStart);
+
+        m_done++;
+        uploaded++;
+        m_status = info.name;
+
+        // Whatever was only waiting on this task can go now
+        for (Task dependent : info.dependents)
+            if (--m_tasks[dependent].waitingOn == 0) start(dependent);
+
+        if (secondsSince(begin) >= budget) break;
+    }
+
+    if (done() && uploaded > 0)
+        printf("Loaded %d tasks in %.2f s (%.2f s of work, done on %d threads + the main thread)\n",
+               (int) m_tasks.size(), secondsSince(m_startTime), m_busyTime, ThreadPool::get().threadCount());
+    return done();
+}
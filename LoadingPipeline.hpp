@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <chrono>
+
+/*
+ Loads the game in parallel while the main thread keeps drawing frames (the loading screen). Loading
+ is split up into tasks, each made of up to 2 halves:
+    1) work: everything which doesn't need the GL context (reading & decoding files, generating
+       geometry), which runs on the thread pool
+    2) upload: creating the GL objects out of what the work made, which runs on the main thread
+ A task only starts once every task it depends on is done (both halves), & tasks which don't depend
+ on each other run side by side - so loading takes about as long as its slowest chain of tasks,
+ rather than as long as all of them put together.
+
+ Once per frame, update() runs the uploads which are ready, until it runs out of time for the frame.
+ */
+class LoadingPipeline {
+public:
+    typedef int Task;
+
+private:
+    struct TaskInfo {
+        std::string name;
+        std::function<void()> work;     // either one of these may be empty
+        std::function<void()> upload;
+        std::vector<Task> dependents;
+        int waitingOn;                  // dependencies which aren't done yet
+        double workTime;                // in seconds
+    };
+
+    std::vector<TaskInfo> m_tasks;
+    int m_done;
+    std::string m_status;
+    std::chrono::steady_clock::time_point m_startTime;
+    double m_busyTime;                  // total time spent in the tasks (in seconds)
+
+    std::mutex m_mutex;                 // guards m_worked
+    std::vector<Task> m_worked;         // tasks whose work is done, waiting for their upload
+
+    void start(Task task);
+    void worked(Task task);
+
+public:
+    LoadingPipeline() : m_done(0), m_busyTime(0.0) {};
+
+    // Adds a task which runs after all of its dependencies (which have to be added first)
+    Task add(const std::string& name, std::function<void()> work, std::function<void()> upload,
+             const std::vector<Task>& dependencies = {});
+
+    // Starts every task which doesn't depend on any other
+    void start();
+
+    // Runs the uploads which are ready, for up to budget seconds - returns true once every task is
+    // done
+    bool update(double budget);
+
+    bool done() const               { return m_done == (int) m_tasks.size(); };
+    float progress() const          { return m_tasks.empty() ? 1.0f : (float) m_done / m_tasks.size(); };
+    const std::string& status() const   { return m_status; };   // name of the last task to be done
+};
@@ -1,5 +1,7 @@
 #include "Object.hpp"
 #include "Scene.hpp"
+#include "GLState.hpp"
+#include "DebugDraw.hpp"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -7,195 +9,154 @@
 using namespace std;
 using namespace glm;
 
-Mesh::Mesh(ShaderProgram* shader, Scene* scene, aiMesh* mesh, const aiScene* aiscene, string texturePrefix) : Object(shader, scene)
-{
-    // VAO is already bound
-    m_shader->enable();
-    
-    // Initialize our bounding box bounds
-    m_minBounds = vec3(0.0f);
-    m_maxBounds = vec3(0.0f);
-    
-    // Copy vertex data from assimp mesh
-    struct VertexData {
-        vec3 position;
-        vec3 normal;
-        vec2 texCoords;
-    };
-    VertexData* vertexData = new VertexData[ mesh->mNumVertices ];
-    for (int i=0; i < mesh->mNumVertices; i++)
-    {
-        VertexData vtx;
-        vtx.position      = vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-        vtx.normal        = vec3(mesh->mNormals[i].x,  mesh->mNormals[i].y,  mesh->mNormals[i].z);
-        if (mesh->mTextureCoords[0])
-            vtx.texCoords = vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
-        else
-            vtx.texCoords = vec2(0.0f);
-        
-        vertexData[i] = vtx;
-        
-        // Update bounding box
-        if (vtx.position.x < m_minBounds.x) m_minBounds.x = vtx.position.x;
-        if (vtx.position.x > m_maxBounds.x) m_maxBounds.x = vtx.position.x;
-
-        if (vtx.position.y < m_minBounds.y) m_minBounds.y = vtx.position.y;
-        if (vtx.position.y > m_maxBounds.y) m_maxBounds.y = vtx.position.y;
+/***********************************************************
+                    Shared mesh assets
+ ***********************************************************/
 
-        if (vtx.position.z < m_minBounds.z) m_minBounds.z = vtx.position.z;
-        if (vtx.position.z > m_maxBounds.z) m_maxBounds.z = vtx.position.z;
-    }
-    // Store to VBO - note that this is possible bc the struct's memory layout is sequential
-    glGenBuffers(1, &m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexData) * mesh->mNumVertices, vertexData, GL_STATIC_DRAW);
-    
-    // Copy index data from assimp mesh
-    vector<GLuint> indices;
-    for (int i=0; i < mesh->mNumFaces; i++)
-    {
-        aiFace face = mesh->mFaces[i];
-        for (int j=0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
-    }
-    m_numIndices = (int) indices.size();
-    m_ebo = storeToEBO(&indices[0], (int) indices.size() * sizeof(GLuint));
-    
-    // Load the 3 associated textures into texture units 0-2
-    glActiveTexture(GL_TEXTURE0);
-    m_textureIDs.push_back( storeTex(texturePrefix + "_diffuse.png") );
-    
+// Uploads a mesh of a cooked model to the GPU
+// Note: this only happens once per mesh of each model file - see ModelAsset::load
+MeshAsset* Mesh::createAsset(const CookedMesh& mesh, string texturePrefix)
+{
+    MeshAsset* asset = new MeshAsset();
+    
+    glGenVertexArrays(1, &asset->vao);
+    glBindVertexArray(asset->vao);
+    
+    // The CPU keeps its own copy of the geometry (for collisions & static batching)
+    asset->vertices = mesh.vertices;
+    asset->indices = mesh.indices;
+    asset->numIndices = (int) asset->indices.size();
+    asset->minBounds = mesh.minBounds;
+    asset->maxBounds = mesh.maxBounds;
+    
+    // The GPU gets a compact copy of the vertices (see VertexFormat.hpp)
+    asset->quantization = Quantization::fit(asset->vertices);
+    vector<PackedVertex> packed;
+    packed.reserve(asset->vertices.size());
+    for (const MeshVertex& vtx : asset->vertices) packed.push_back(asset->quantization.pack(vtx));
+    asset->vbo = storeToVBO(packed.data(), (int) (sizeof(PackedVertex) * packed.size()));
+    asset->ebo = storeIndices(asset->indices, asset->vertices.size(), asset->indexType);
+    
+    // Load the diffuse texture
     /*
      Note: disabling specular & normal mapping because not all the objects have these & the objects
      that do have them look just fine without it
      */
-//    glActiveTexture(GL_TEXTURE1);
-//    m_textureIDs.push_back( storeTex(texturePrefix + "_specular.png") );
-//
-//    glActiveTexture(GL_TEXTURE2);
-//    m_textureIDs.push_back( storeTex(texturePrefix + "_normal.png") );
+    asset->texture = storeTex(texturePrefix + "_diffuse.png");
+    
+    glBindBuffer(GL_ARRAY_BUFFER, asset->vbo);
+    PackedVertex::setAttributes();
     
-    // Tell OpenGL where to find/how to interpret...
-    //      1) The vertex positions
-    GLint location = m_shader->getAttribLocation("position");
-    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
-    glEnableVertexAttribArray(location);
+    // A second, position-only layout for depth-only passes (see MeshAsset)
+    glGenVertexArrays(1, &asset->shadowVao);
+    glBindVertexArray(asset->shadowVao);
     
-    //      2) The vertex normals
-    location = m_shader->getAttribLocation("normal");
-    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, normal));
-    glEnableVertexAttribArray(location);
+    vector<GLshort> positions;
+    positions.reserve(packed.size() * 4);
+    for (const PackedVertex& vtx : packed) positions.insert(positions.end(), vtx.position, vtx.position + 4);
+    asset->positionVbo = storeToVBO(positions.data(), (int) (sizeof(GLshort) * positions.size()));
     
-    //      3) The texture coordinates
-    location = m_shader->getAttribLocation("textureCoords");
-    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, texCoords));
-    glEnableVertexAttribArray(location);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, asset->ebo);
+    PackedVertex::setPositionAttribute();
     
-    //      4) The diffuse texture uniform
-    glActiveTexture(GL_TEXTURE0);
-    location = m_shader->getUniformLocation("DiffuseTexture");
-    glUniform1i(location, 0);   // texture unit 0
+    glBindVertexArray( 0 );
+    
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    GLState::get().invalidate();    // everything above was bound without the state tracker
+    
+    CHECK_GL_ERRORS;
+    return asset;
+}
+
+/***********************************************************
+                      Mesh instances
+ ***********************************************************/
+
+Mesh::Mesh(Shader* shader, Scene* scene, MeshAsset* asset) : Object(shader, scene), m_asset(asset)
+{
+    // Use the asset's GPU data instead of the VAO the base class generated for us
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &m_vao);
+    m_vao = asset->vao;
+    m_vbo = asset->vbo;
+    m_ebo = asset->ebo;
+    m_textureIDs.push_back(asset->texture);
+    m_numIndices = asset->numIndices;
+    
+    m_minBounds = asset->minBounds;
+    m_maxBounds = asset->maxBounds;
+    
+    // Note: mesh objects use the same material as the terrain
+    setMaterial(vec3(1.0, 1.0, 1.0), // kd
+                vec3(0.1, 0.1, 0.1), // ks
+                32);                 // shininess
+    
+    // The diffuse texture uniform
+    m_shader->enable();
+    m_shader->set(Uniform::DiffuseTexture, 0);   // texture unit 0
     
 //    //      5) The specular texture uniform
-//    glActiveTexture(GL_TEXTURE1);
 //    location = m_shader->getUniformLocation("SpecularTexture");
 //    glUniform1i(location, 1);   // texture unit 1
 //
 //    //      6) The normal map uniform
-//    glActiveTexture(GL_TEXTURE2);
 //    location = m_shader->getUniformLocation("NormalMap");
 //    glUniform1i(location, 2);   // texture unit 2
     
     m_shader->disable();
-    glBindVertexArray( 0 );
-    releaseData();
-    
-    initBoundingBoxData();
 }
 
 Mesh::~Mesh()
 {
-    glDeleteVertexArrays(1, &bb_vao);
-    glDeleteBuffers(1, &bb_vbo);
-}
-
-
-void Mesh::uploadCustomUniforms(Mode m)
-{
-    GLint location = m_shader->getUniformLocation("IsTerrainObject");
-    glUniform1i(location, false);
-    
-    location = m_shader->getUniformLocation("IsMeshObject");
-    glUniform1i(location, true);
+    // The GPU data belongs to the asset, which is shared with the other instances - make sure the
+    // base class destructor doesn't delete any of it
+    m_vao = 0;
+    m_vbo = 0;
+    m_ebo = 0;
+    m_textureIDs.clear();
 }
 
-void Mesh::bindData()
+ObjectUniforms Mesh::objectUniforms(Mode m)
 {
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_textureIDs[0]);
-
-//    glActiveTexture(GL_TEXTURE1);
-//    glBindTexture(GL_TEXTURE_2D, m_textureIDs[1]);
-//
-//    glActiveTexture(GL_TEXTURE2);
-//    glBindTexture(GL_TEXTURE_2D, m_textureIDs[2]);
-
-    CHECK_GL_ERRORS;
+    ObjectUniforms data = Object::objectUniforms(m);
+    data.flags.y = true; // is mesh object
+    data.dequantScale = m_asset->quantization.scale();
+    data.dequantOffset = m_asset->quantization.offset();
+    return data;
 }
 
-void Mesh::drawElements()
+void Mesh::describeDraw(DrawPacket& packet)
 {
-    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, nullptr);
-    CHECK_GL_ERRORS;
+    packet.addTexture(GL_TEXTURE_2D, m_textureIDs[0]);   // texture unit 0
+    
+    packet.primitive = GL_TRIANGLES;
+    packet.count = m_numIndices;
+    packet.indexType = m_asset->indexType;
 }
 
-void Mesh::releaseData()
+bool Mesh::worldBounds(AABB& box)
 {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-//    glActiveTexture(GL_TEXTURE1);
-//    glBindTexture(GL_TEXTURE_2D, 0);
-//
-//    glActiveTexture(GL_TEXTURE2);
-//    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
-    
-    CHECK_GL_ERRORS;
+    box = AABB::transform(modelMatrix(), m_minBounds, m_maxBounds);
+    return true;
 }
 
-void Mesh::renderToShadowMap()
+void Mesh::submitToShadowMap(RenderQueue& queue)
 {
-    // Minimalistic rendering: we only need to bind the position data & model matrix, then render
-    glBindVertexArray(m_vao);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-    
-    struct VertexData {
-        vec3 position;
-        vec3 normal;
-        vec2 texCoords;
-    };
-    GLint location = m_scene->shadowShader()->getAttribLocation("position");
-    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
-    glEnableVertexAttribArray(location);
+    // Skip meshes which are outside of the sun's shadow volume
+    AABB box;
+    if (worldBounds(box) && !queue.isVisible(box)) return;
     
-    mat4 model = modelMatrix();
-    location = m_scene->shadowShader()->getUniformLocation("Model");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(model));
+    // Minimalistic rendering: we only need the position data & model matrix
+    DrawPacket packet;
+    packet.shader = m_scene->shadowShader();
+    packet.vao = m_asset->shadowVao;
+    packet.uniforms = objectUniforms(SHADOW_MAP);
     
-    drawElements();
+    packet.primitive = GL_TRIANGLES;
+    packet.count = m_numIndices;
+    packet.indexType = m_asset->indexType;
     
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    
-    CHECK_GL_ERRORS;
+    queue.submit(packet);
 }
 
 
@@ -203,114 +164,9 @@ void Mesh::renderToShadowMap()
                       Bounding Box
  ***********************************************************/
 
-void Mesh::initBoundingBoxData()
-{
-    // Load bounding box data
-    glGenVertexArrays(1, &bb_vao);
-    glBindVertexArray(bb_vao);
-    
-    bb_shader.generateProgramObject();
-    bb_shader.attachVertexShader( string("Assets/Shaders/BBVtxShader.vs").c_str() );
-    bb_shader.attachFragmentShader( string("Assets/Shaders/BBFragShader.fs").c_str() );
-    bb_shader.link();
-    
-    bb_shader.enable();
-    
-    GLfloat vertices[] = {
-        m_maxBounds.x, m_minBounds.y, m_minBounds.z,   // Back face
-        m_maxBounds.x, m_maxBounds.y, m_minBounds.z,
-        m_minBounds.x, m_minBounds.y, m_minBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_minBounds.z,
-        m_minBounds.x, m_minBounds.y, m_minBounds.z,
-        m_minBounds.x, m_maxBounds.y, m_minBounds.z,
-        
-        m_minBounds.x, m_minBounds.y, m_maxBounds.z,   // Front face
-        m_minBounds.x, m_maxBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_minBounds.y, m_maxBounds.z,
-        m_minBounds.x, m_maxBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_minBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_maxBounds.z,
-        
-        m_minBounds.x, m_minBounds.y, m_minBounds.z,   // Left face
-        m_minBounds.x, m_maxBounds.y, m_minBounds.z,
-        m_minBounds.x, m_minBounds.y, m_maxBounds.z,
-        m_minBounds.x, m_maxBounds.y, m_minBounds.z,
-        m_minBounds.x, m_minBounds.y, m_maxBounds.z,
-        m_minBounds.x, m_maxBounds.y, m_maxBounds.z,
-        
-        m_maxBounds.x, m_minBounds.y, m_maxBounds.z,    // Right face
-        m_maxBounds.x, m_maxBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_minBounds.y, m_minBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_minBounds.y, m_minBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_minBounds.z,
-        
-        m_maxBounds.x, m_minBounds.y, m_maxBounds.z,     // Bottom face
-        m_maxBounds.x, m_minBounds.y, m_minBounds.z,
-        m_minBounds.x, m_minBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_minBounds.y, m_minBounds.z,
-        m_minBounds.x, m_minBounds.y, m_maxBounds.z,
-        m_minBounds.x, m_minBounds.y, m_minBounds.z,
-        
-        m_minBounds.x, m_maxBounds.y, m_maxBounds.z,    // Top face
-        m_minBounds.x, m_maxBounds.y, m_minBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_maxBounds.z,
-        m_minBounds.x, m_maxBounds.y, m_minBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_maxBounds.z,
-        m_maxBounds.x, m_maxBounds.y, m_minBounds.z,
-    };
-    bb_vbo = storeToVBO(vertices, sizeof(vertices));
-    
-    GLint location = bb_shader.getAttribLocation("position");
-    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    glEnableVertexAttribArray(location);
-    
-    bb_shader.disable();
-    glBindVertexArray(0);
-}
-
-void Mesh::renderBoundingBox(Mode mode)
+void Mesh::drawBoundingBox(vec4 colour)
 {
-    glBindVertexArray(bb_vao);
-    bb_shader.enable();
-    glBindBuffer( GL_ARRAY_BUFFER, bb_vbo );
-    
-    mat4 model = modelMatrix();
-    GLint location = bb_shader.getUniformLocation("Model");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(model));
-    
-    mat4 view = m_scene->camera()->viewMatrix();
-    location = bb_shader.getUniformLocation("View");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(view));
-
-    mat4 projection = m_scene->camera()->projMatrix();
-    location = bb_shader.getUniformLocation("Projection");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(projection));
-    
-    bool clippingEnabled = mode == REFLECTION || mode == REFRACTION;
-    location = bb_shader.getUniformLocation("ClippingEnabled");
-    glUniform1f(location, clippingEnabled);
-    
-    if (clippingEnabled)
-    {
-        vec4 clippingPlane;
-        if (mode == REFLECTION)
-            clippingPlane = vec4(0, 1, 0, m_scene->water()->position().y);
-        else if (mode == REFRACTION)
-            clippingPlane = vec4(0, -1, 0, m_scene->water()->position().y + 1.0f);
-        
-        location = bb_shader.getUniformLocation("ClippingPlane");
-        glUniform4fv(location, 1, value_ptr(clippingPlane));
-    }
-    CHECK_GL_ERRORS;
-    
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
-    bb_shader.disable();
-    glBindVertexArray(0);
-    
-    CHECK_GL_ERRORS;
+    DebugDraw::get().box(m_minBounds, m_maxBounds, colour, modelMatrix());
 }
 
 bool Mesh::collision(Mesh* m)
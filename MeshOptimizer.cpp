@@ -0,0 +1,303 @@
+#include "MeshOptimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace glm;
+
+//#define DEBUG_PRINT
+
+// Analysis -----------------------------------------------------------------------------------
+
+// Simulates a FIFO post-transform cache, & returns how many of the triangle's vertices missed it
+static int simulateTriangle(const GLuint* tri, vector<int>& timestamps, int& time)
+{
+    int misses = 0;
+    for (int k=0; k<3; k++) {
+        GLuint v = tri[k];
+
+        // A vertex is still cached if fewer than ANALYSIS_CACHE_SIZE vertices were added since it was
+        if (timestamps[v] == -1 || time - timestamps[v] > ANALYSIS_CACHE_SIZE) {
+            timestamps[v] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+VertexCacheStats analyzeVertexCache(const vector<GLuint>& indices, size_t numVertices)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (indices.empty()) return stats;
+
+    vector<int> timestamps(numVertices, -1);    // when each vertex entered the cache
+    vector<bool> used(numVertices, false);
+    int time = 0, misses = 0, unique = 0;
+
+    for (size_t i=0; i+2<indices.size(); i+=3) {
+        misses += simulateTriangle(&indices[i], timestamps, time);
+        for (int k=0; k<3; k++) {
+            if (!used[indices[i+k]]) unique++;
+            used[indices[i+k]] = true;
+        }
+    }
+
+    stats.acmr = (float) misses / (float) (indices.size() / 3);
+    stats.atvr = (float) misses / (float) unique;
+    return stats;
+}
+
+// Vertex cache -------------------------------------------------------------------------------
+
+/*
+ Forsyth's algorithm greedily picks the triangle with the highest score next, where a triangle's
+ score is the sum of the scores of its vertices. Vertices score higher the more recently they were
+ used (they're likely still in the cache) & the fewer triangles they have left (finishing a vertex
+ off means it never has to be transformed again).
+ */
+static const int FORSYTH_CACHE_SIZE = 32;           // modelled as LRU
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;     // the 3 most recent vertices all score the same
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, int remainingTriangles)
+{
+    if (remainingTriangles == 0) return -1.0f;  // no triangles left - the vertex doesn't matter anymore
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+            score = pow(1.0f - (float) (cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+
+    return score + VALENCE_BOOST_SCALE * pow((float) remainingTriangles, -VALENCE_BOOST_POWER);
+}
+
+void optimizeVertexCache(vector<GLuint>& indices, size_t numVertices)
+{
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles == 0) return;
+
+    // Triangles which use each vertex (offsets into one big list)
+    vector<int> remaining(numVertices, 0);
+    for (GLuint index : indices) remaining[index]++;
+
+    vector<int> firstTriangle(numVertices + 1, 0);
+    for (size_t v=0; v<numVertices; v++) firstTriangle[v+1] = firstTriangle[v] + remaining[v];
+    vector<int> adjacency(indices.size());
+    vector<int> filled(numVertices, 0);
+    for (size_t t=0; t<numTriangles; t++)
+        for (int k=0; k<3; k++) {
+            GLuint v = indices[t*3 + k];
+            adjacency[firstTriangle[v] + filled[v]++] = (int) t;
+        }
+
+    vector<int> cachePosition(numVertices, -1);
+    vector<float> score(numVertices);
+    for (size_t v=0; v<numVertices; v++) score[v] = vertexScore(-1, remaining[v]);
+
+    vector<float> triangleScore(numTriangles);
+    for (size_t t=0; t<numTriangles; t++)
+        triangleScore[t] = score[indices[t*3]] + score[indices[t*3+1]] + score[indices[t*3+2]];
+
+    vector<bool> emitted(numTriangles, false);
+    vector<GLuint> result;
+    result.reserve(indices.size());
+
+    vector<GLuint> cache;   // most recently used first
+    size_t nextUnemitted = 0;
+    int best = -1;
+
+    while (result.size() < indices.size()) {
+        // Nothing in the cache has any triangles left: start over from the next triangle in the
+        // original order (this keeps the whole thing linear)
+        if (best == -1) {
+            while (emitted[nextUnemitted]) nextUnemitted++;
+            best = (int) nextUnemitted;
+        }
+
+        // Emit the triangle & move its vertices to the front of the cache
+        emitted[best] = true;
+        vector<GLuint> newCache;
+        for (int k=0; k<3; k++) {
+            GLuint v = indices[best*3 + k];
+            result.push_back(v);
+            newCache.push_back(v);
+
+            // This triangle is done, so it no longer counts towards its vertices
+            int* begin = &adjacency[firstTriangle[v]];
+            int* end = begin + remaining[v];
+            *find(begin, end, best) = *(end - 1);
+            remaining[v]--;
+        }
+        for (GLuint v : cache)
+            if (find(newCache.begin(), newCache.end(), v) == newCache.end()) newCache.push_back(v);
+
+        // Vertices pushed out of the cache lose their cache bonus
+        for (size_t i=FORSYTH_CACHE_SIZE; i<newCache.size(); i++) {
+            cachePosition[newCache[i]] = -1;
+            score[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        }
+        if (newCache.size() > FORSYTH_CACHE_SIZE) newCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(newCache);
+
+        // Update the scores of everything in the cache & pick the best of their triangles next
+        for (size_t i=0; i<cache.size(); i++) {
+            cachePosition[cache[i]] = (int) i;
+            score[cache[i]] = vertexScore((int) i, remaining[cache[i]]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (GLuint v : cache) {
+            for (int a=0; a<remaining[v]; a++) {
+                int t = adjacency[firstTriangle[v] + a];
+                triangleScore[t] = score[indices[t*3]] + score[indices[t*3+1]] + score[indices[t*3+2]];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+// Overdraw -----------------------------------------------------------------------------------
+
+void optimizeOverdraw(vector<GLuint>& indices, const vector<MeshVertex>& vertices, float threshold)
+{
+    size_t numTriangles = indices.size() / 3;
+    if (numTriangles < 2) return;
+
+    // 1) Hard boundaries: triangles which miss the cache with all 3 vertices start a new cluster
+    //    anyways, so moving the clusters between them around costs nothing
+    vector<int> timestamps(vertices.size(), -1);
+    int time = 0;
+    vector<int> misses(numTriangles);
+    vector<size_t> hardBoundaries;
+    for (size_t t=0; t<numTriangles; t++) {
+        misses[t] = simulateTriangle(&indices[t*3], timestamps, time);
+        if (t == 0 || misses[t] == 3) hardBoundaries.push_back(t);
+    }
+    hardBoundaries.push_back(numTriangles);
+
+    // 2) Soft boundaries: split the hard clusters further, as long as each piece keeps its cache
+    //    efficiency within threshold of the hard cluster's. The pieces may end up being drawn in any
+    //    order, so each one is simulated starting from an empty cache
+    vector<size_t> clusters;
+    for (size_t c=0; c+1<hardBoundaries.size(); c++) {
+        size_t start = hardBoundaries[c], end = hardBoundaries[c+1];
+
+        int clusterMisses = 0;
+        for (size_t t=start; t<end; t++) clusterMisses += misses[t];
+        float maxAcmr = threshold * (float) clusterMisses / (float) (end - start);
+
+        clusters.push_back(start);
+        time += ANALYSIS_CACHE_SIZE + 1;    // flushes the cache
+        int pieceMisses = 0;
+        size_t pieceStart = start;
+        for (size_t t=start; t<end; t++) {
+            pieceMisses += simulateTriangle(&indices[t*3], timestamps, time);
+
+            // Once this piece is efficient enough, the next triangle starts a new one
+            if ((float) pieceMisses / (float) (t - pieceStart + 1) <= maxAcmr && t + 1 < end) {
+                clusters.push_back(t + 1);
+                pieceStart = t + 1;
+                pieceMisses = 0;
+                time += ANALYSIS_CACHE_SIZE + 1;
+            }
+        }
+    }
+    clusters.push_back(numTriangles);
+
+    // 3) Sort the clusters: the ones on the outside of the mesh, facing outwards, get drawn first
+    vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    struct Cluster {
+        size_t start, end;
+        vec3 centroid;
+        vec3 normal;
+        float sortKey;
+    };
+    vector<Cluster> sorted;
+    for (size_t c=0; c+1<clusters.size(); c++) {
+        Cluster cluster = { clusters[c], clusters[c+1], vec3(0.0f), vec3(0.0f), 0.0f };
+        float area = 0.0f;
+        for (size_t t=cluster.start; t<cluster.end; t++) {
+            vec3 p0 = vertices[indices[t*3]].position;
+            vec3 p1 = vertices[indices[t*3+1]].position;
+            vec3 p2 = vertices[indices[t*3+2]].position;
+            vec3 n = cross(p1 - p0, p2 - p0);   // length = twice the triangle's area
+            float a = length(n);
+
+            cluster.centroid += (p0 + p1 + p2) / 3.0f * a;
+            cluster.normal += n;
+            area += a;
+        }
+        meshCentroid += cluster.centroid;
+        meshArea += area;
+
+        if (area > 0.0f) cluster.centroid /= area;
+        float normalLength = length(cluster.normal);
+        if (normalLength > 0.0f) cluster.normal /= normalLength;
+        sorted.push_back(cluster);
+    }
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    for (Cluster& cluster : sorted) cluster.sortKey = dot(cluster.centroid - meshCentroid, cluster.normal);
+    stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    vector<GLuint> result;
+    result.reserve(indices.size());
+    for (Cluster& cluster : sorted)
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    indices.swap(result);
+}
+
+// Vertex fetch -------------------------------------------------------------------------------
+
+vector<GLuint> optimizeVertexFetch(vector<GLuint>& indices, size_t numVertices)
+{
+    const GLuint UNUSED = (GLuint) -1;
+    vector<GLuint> remap(numVertices, UNUSED);
+
+    GLuint next = 0;
+    for (GLuint& index : indices) {
+        if (remap[index] == UNUSED) remap[index] = next++;
+        index = remap[index];
+    }
+    for (GLuint& r : remap)
+        if (r == UNUSED) r = next++;
+
+    return remap;
+}
+
+// --------------------------------------------------------------------------------------------
+
+void optimizeMesh(const string& name, vector<MeshVertex>& vertices, vector<GLuint>& indices)
+{
+#ifdef DEBUG_PRINT
+    VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+#endif
+
+    optimizeVertexCache(indices, vertices.size());
+    optimizeOverdraw(indices, vertices);
+
+    vector<GLuint> remap = optimizeVertexFetch(indices, vertices.size());
+    vector<MeshVertex> reordered(vertices.size());
+    for (size_t v=0; v<vertices.size(); v++) reordered[remap[v]] = vertices[v];
+    vertices.swap(reordered);
+
+#ifdef DEBUG_PRINT
+    VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+    cout << "Optimized " << name << " (" << indices.size() / 3 << " triangles): "
+         << "ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+#else
+    (void) name;    // only used for the statistics
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "VertexFormat.hpp"
+#include <vector>
+#include <string>
+
+/*
+ Reorders the triangles & vertices of indexed triangle lists so that the GPU has less work to do.
+ These only change the order in which things are drawn, never what gets drawn, & are run once
+ when a mesh gets loaded:
+    1) optimizeVertexCache: orders the triangles so that the vertices they share are still in the
+       GPU's post-transform cache (Forsyth's "Linear-Speed Vertex Cache Optimisation")
+    2) optimizeOverdraw: splits the result of 1) into clusters & draws the clusters which face
+       away from the center of the mesh first, since they are the most likely to occlude the rest
+       (Sander, Nehab & Barczak's "Fast Triangle Reordering for Vertex Locality & Reduced Overdraw")
+    3) optimizeVertexFetch: orders the vertices by first use, so that fetching them reads memory
+       sequentially
+ */
+
+// How well an index buffer uses the post-transform cache, measured with a FIFO cache of
+// ANALYSIS_CACHE_SIZE vertices (a conservative estimate of what the hardware has)
+struct VertexCacheStats {
+    float acmr;     // average cache miss ratio: vertices transformed per triangle (0.5 - 3)
+    float atvr;     // average transform to vertex ratio: vertices transformed per vertex (1 is optimal)
+};
+
+static const int ANALYSIS_CACHE_SIZE = 16;
+
+VertexCacheStats analyzeVertexCache(const std::vector<GLuint>& indices, size_t numVertices);
+
+void optimizeVertexCache(std::vector<GLuint>& indices, size_t numVertices);
+
+// Clusters may lose up to threshold times the cache efficiency of the order they came in, so this
+// must be run on indices which were already optimized for the vertex cache
+void optimizeOverdraw(std::vector<GLuint>& indices, const std::vector<MeshVertex>& vertices, float threshold = 1.05f);
+
+// Returns the new position of every vertex (unused vertices are moved to the end) - the indices
+// are remapped in place
+std::vector<GLuint> optimizeVertexFetch(std::vector<GLuint>& indices, size_t numVertices);
+
+// Applies all 3 of the above to a mesh (& prints its statistics before & after with DEBUG_PRINT, see
+// MeshOptimizer.cpp)
+void optimizeMesh(const std::string& name, std::vector<MeshVertex>& vertices, std::vector<GLuint>& indices);
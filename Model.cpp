@@ -3,43 +3,16 @@
 using namespace std;
 using namespace glm;
 
-//#define DEBUG_PRINT
-
-Model::Model(ShaderProgram* shader, Scene* scene, string path) : Renderable(),
+Model::Model(Shader* shader, Scene* scene, string path) : Renderable(),
     m_scene(scene), m_position(vec3(0.0)), m_facing(vec3(0.0f, 0.0f, -1.0f))
 {
-#ifdef DEBUG_PRINT
-    cout << "Loading data for model: " << path << endl;
-#endif
-    // Load the model into an assimp scene object
-    Assimp::Importer importer;
-    const aiScene* aiscene = importer.ReadFile(path, aiProcess_Triangulate);
-    
-    if (!aiscene || aiscene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !aiscene->mRootNode) {
-        cout << "Error loading model at " << path << ": " << importer.GetErrorString() << endl;
-        return;
-    }
+    // The file only gets imported the first time a model is loaded from it - after that, every
+    // model made from the same file shares its meshes' GPU data & only has its own transformations
+    ModelAsset* asset = ModelAsset::load(path);
+    if (!asset) return;
     
-    string texturefolder = path.substr(0, path.find_last_of('/') + 1);
-    generateMeshesRecursively(shader, scene, aiscene->mRootNode, aiscene, texturefolder);
-}
-
-void Model::generateMeshesRecursively(ShaderProgram* shader, Scene* scene, aiNode* node, const aiScene* aiscene, string texturefolder)
-{
-    // Process all the meshes
-    for (int i=0; i < node->mNumMeshes; i++) {
-        
-        aiMesh* mesh = aiscene->mMeshes[node->mMeshes[i]];
-#ifdef DEBUG_PRINT
-        cout << "\tCreating mesh: " << mesh->mName.C_Str() << endl;
-#endif
-        string texturePrefix = texturefolder + string(mesh->mName.C_Str());
-        m_modelMeshes.push_back(new Mesh(shader, scene, mesh, aiscene, texturePrefix));
-    }
-    
-    // Recurse on the node's children
-    for (int i=0; i < node->mNumChildren; i++)
-        generateMeshesRecursively(shader, scene, node->mChildren[i], aiscene, texturefolder);
+    for (MeshAsset* meshAsset : asset->meshes)
+        m_modelMeshes.push_back(new Mesh(shader, scene, meshAsset));
 }
 
 Model::~Model()
@@ -49,22 +22,28 @@ Model::~Model()
     }
 }
 
-void Model::render(Mode m)
+void Model::submit(RenderQueue& queue, Mode m)
 {
     for (Mesh* mesh : m_modelMeshes)
-        mesh->render(m);
+        mesh->submit(queue, m);
 }
 
-void Model::renderToShadowMap()
+void Model::submitToShadowMap(RenderQueue& queue)
 {
     for (Mesh* mesh : m_modelMeshes)
-        mesh->renderToShadowMap();
+        mesh->submitToShadowMap(queue);
 }
 
-void Model::renderBoundingBox(Mode m)
+void Model::drawBoundingBoxes(vec4 colour)
 {
     for (Mesh* mesh : m_modelMeshes)
-        mesh->renderBoundingBox(m);
+        mesh->drawBoundingBox(colour);
+}
+
+mat4 Model::modelMatrix()
+{
+    if (m_modelMeshes.empty()) return mat4(1.0f);
+    return m_modelMeshes[0]->modelMatrix();
 }
 
 bool Model::collision(Model* m)
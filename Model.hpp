@@ -2,9 +2,6 @@
 
 #define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 #include <random>
 #include "Renderable.hpp"
 #include "Object.hpp"
@@ -22,20 +19,20 @@ protected:
     glm::vec3 m_position;
     glm::vec3 m_facing;
     
-    void generateMeshesRecursively(ShaderProgram* shader, Scene* scene, aiNode* node, const aiScene* aiscene, std::string texturefolder);
-    
 public:
-    Model(ShaderProgram* shader, Scene* scene, std::string objFilePath);
+    Model(Shader* shader, Scene* scene, std::string objFilePath);
     ~Model();
     
-    void render(Mode mode) final;
-    void renderToShadowMap() final;
-    void renderBoundingBox(Mode m);
+    void submit(RenderQueue& queue, Mode mode) final;
+    void submitToShadowMap(RenderQueue& queue) final;
+    void drawBoundingBoxes(glm::vec4 colour);   // through DebugDraw
     
     bool collision(Model* m);
     
     glm::vec3 position() { return m_position; };
     glm::vec3 facing() { return m_facing; };
+    glm::mat4 modelMatrix();    // all the meshes of a model share the same transformation
+    const std::vector<Mesh*>& meshes() { return m_modelMeshes; };
     
     void setPosition(glm::vec3 p);
     void setSize(float s);
@@ -54,7 +51,9 @@ class Character : public Model {
     float getDepthDampeningFactor();
     
 public:
-    Character(ShaderProgram* shader, Scene* scene);
+    static const char* const MODEL_PATH;
+    
+    Character(Shader* shader, Scene* scene);
     
     void reset();
     void glide();
@@ -80,7 +79,9 @@ class Fish : public Model {
     bool collisionExists();
     
 public:
-    Fish(ShaderProgram* shader, Scene* scene, int id);
+    static const char* const MODEL_PATH;
+    
+    Fish(Shader* shader, Scene* scene, int id);
     
     void reset();
     void swim();
@@ -93,7 +94,9 @@ public:
 class TerrainObject : public Model {
     
 public:
-    TerrainObject(ShaderProgram* shader, Scene* scene, std::string path);
+    TerrainObject(Shader* shader, Scene* scene, std::string path);
     
     void setOnTerrain(float x, float z);
+    
+    bool isStatic() override { return true; };
 };
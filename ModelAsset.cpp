@@ -0,0 +1,70 @@
+#include "ModelAsset.hpp"
+#include "Object.hpp"
+#include "CookedModel.hpp"
+#include <unordered_map>
+#include <mutex>
+#include <iostream>
+
+using namespace std;
+using namespace glm;
+
+//#define DEBUG_PRINT
+
+// Model cache
+static unordered_map<string, ModelAsset*> modelCache;
+
+// Models which were imported ahead of time by prepare(), waiting for load() to upload them
+static mutex preparedMutex;
+static unordered_map<string, CookedModel> preparedModels;
+
+void ModelAsset::prepare(const string& path)
+{
+    CookedModel model;
+    if (!model.load(path) && !model.cook(path)) return;     // load() will report the error
+    
+    lock_guard<mutex> lock(preparedMutex);
+    preparedModels[path] = move(model);
+}
+
+// Takes the model prepared for path, if there is one
+static bool takePrepared(const string& path, CookedModel& model)
+{
+    lock_guard<mutex> lock(preparedMutex);
+    auto it = preparedModels.find(path);
+    if (it == preparedModels.end()) return false;
+    
+    model = move(it->second);
+    preparedModels.erase(it);
+    return true;
+}
+
+ModelAsset* ModelAsset::load(const string& path)
+{
+    // Check if this particular model has already been loaded & return it if so
+    auto it = modelCache.find(path);
+    if (it != modelCache.end()) return it->second;
+    
+#ifdef DEBUG_PRINT
+    cout << "Loading data for model: " << path << endl;
+#endif
+    // Only import the model file itself if it hasn't been cooked yet (or has changed since)
+    CookedModel model;
+    if (!takePrepared(path, model) && !model.load(path) && !model.cook(path)) {
+        modelCache[path] = nullptr;     // don't try again for every instance
+        return nullptr;
+    }
+    
+    ModelAsset* asset = new ModelAsset();
+    asset->path = path;
+    
+    string texturefolder = path.substr(0, path.find_last_of('/') + 1);
+    for (CookedMesh& mesh : model.meshes) {
+#ifdef DEBUG_PRINT
+        cout << "\tCreating mesh: " << mesh.name << endl;
+#endif
+        asset->meshes.push_back(Mesh::createAsset(mesh, texturefolder + mesh.name));
+    }
+    
+    modelCache[path] = asset;
+    return asset;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/OpenGLImport.hpp"
+#include "VertexFormat.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Everything about a mesh which doesn't depend on where it's placed in the scene: a CPU copy of its
+// geometry, the GPU buffers holding that geometry, its texture & its (model space) bounding box
+struct MeshAsset {
+    std::vector<MeshVertex> vertices;
+    std::vector<GLuint> indices;
+    
+    GLuint vao;             // vertex layout + element buffer, usable with any of our mesh shaders
+    GLuint vbo;             // PackedVertex's
+    GLuint ebo;
+    GLenum indexType;       // 16 bit indices whenever the mesh has few enough vertices
+    Quantization quantization;
+    
+    // Depth-only passes (ie. the shadow map) only read positions, so they get a tightly packed stream
+    // of those (8 bytes per vertex instead of 16) with its own VAO, which shares the element buffer
+    GLuint shadowVao;
+    GLuint positionVbo;
+
+    GLuint texture;
+    int numIndices;
+    
+    glm::vec3 minBounds;
+    glm::vec3 maxBounds;
+};
+
+// A model file which has been imported & uploaded to the GPU
+// Models are cached by path, so every model loaded from the same file shares the same asset &
+// only keeps its own transformation
+struct ModelAsset {
+    std::string path;
+    std::vector<MeshAsset*> meshes;
+    
+    static ModelAsset* load(const std::string& path);  // returns nullptr if the file can't be imported
+    
+    // Imports the model file ahead of time, so that load() only has to upload it - doesn't touch
+    // OpenGL, so it can run on a worker thread (see LoadingPipeline)
+    static void prepare(const std::string& path);
+};
@@ -1,14 +1,13 @@
 #include "Object.hpp"
 #include "Scene.hpp"
-#include "lodepng/lodepng.h"
+#include "GLState.hpp"
+#include "TextureLoader.hpp"
 
 using namespace std;
 using namespace glm;
 
-// Texture cache
-unordered_map<string, GLuint> textureCache;
-
-Object::Object(ShaderProgram* shader, Scene* scene) : Renderable(), m_shader(shader), m_scene(scene), m_position(vec3(0.0)), m_rotation(vec3(0, 0, 0)), m_size(1.0f)
+Object::Object(Shader* shader, Scene* scene) : Renderable(), m_shader(shader), m_scene(scene), m_position(vec3(0.0)), m_rotation(vec3(0, 0, 0)), m_size(1.0f),
+    m_kd(vec3(0.0f)), m_ks(vec3(0.0f)), m_shininess(1.0f)
 {
     // Create & bind a vertex array object
     glGenVertexArrays(1, &m_vao);
@@ -32,7 +31,7 @@ Object::~Object()  // Note: Gets called after child class destructor is finished
  ***********************************************************/
 
 // Create, bind, and load data into a vertex buffer object
-GLuint Object::storeToVBO(GLfloat* vertices, int size)
+GLuint Object::storeToVBO(const void* vertices, int size)
 {
     GLuint vbo;
     glGenBuffers(1, &vbo);
@@ -47,7 +46,7 @@ GLuint Object::storeToVBO(GLfloat* vertices, int size)
 }
 
 // Overloaded version of the above function which loads 3 sets of data into 1 buffer
-GLuint Object::storeToVBO(GLfloat* positions, int sizeP, GLfloat* normals, int sizeN, GLfloat* texCoords, int sizeT)
+GLuint Object::storeToVBO(const void* positions, int sizeP, const void* normals, int sizeN, const void* texCoords, int sizeT)
 {
     GLuint vbo;
     glGenBuffers(1, &vbo);
@@ -87,140 +86,62 @@ GLuint Object::storeToEBO(GLuint* indices, int size)
     return ebo;
 }
 
-// Create, bind, and load data into a 2D texture object
-// Note: must set active texture unit FIRST
-GLuint Object::storeTex(string path, GLenum wrapping)
+// Same as above, for 16 bit indices
+GLuint Object::storeToEBO(GLushort* indices, int size)
 {
-    // Check if this particular texture has already been loaded & return its ID if so
-    if (textureCache[path]) return textureCache[path];
-    
-    GLuint tex;
-    glGenTextures(1, &tex);
-    textureCache[path] = tex;
-    glBindTexture(GL_TEXTURE_2D, tex);
-    
-    // Load the image in 32-bit RGBA format
-    unsigned char* data;
-    unsigned width, height;
-    unsigned error = lodepng_decode32_file(&data, &width, &height, path.c_str());
-    if (error) {
-        cerr << "Error decoding " << path << ". " << error << ": " << lodepng_error_text(error) << endl;
-        return tex;
-    }
-    
-    GLenum format = GL_RGBA;
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    free(data);
-    
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapping);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapping);
-    
-    if (wrapping == GL_CLAMP_TO_BORDER) {
-        // Specify a border color
-        float borderColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };   // clear
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-    }
+    GLuint ebo;
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
     
     CHECK_GL_ERRORS;
-    return tex;
+    return ebo;
 }
 
-// Create, bind, and load data into a texture cube map
+// Create a 2D texture object & start loading the image into it (see TextureLoader)
 // Note: must set active texture unit FIRST
-GLuint Object::storeCubeMap(vector<string>& faces)
+GLuint Object::storeTex(string path, GLenum wrapping)
 {
-    GLuint tex;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
-    
-    unsigned char* data;
-    unsigned width, height;
-    for (int i = 0; i < faces.size(); i++) {
-        // Load the image in 32-bit RGBA format
-        unsigned error = lodepng_decode32_file(&data, &width, &height, faces[i].c_str());
-        if (error) {
-            cerr << "Error decoding " << faces[i].c_str() << ". " << error << ": " << lodepng_error_text(error) << endl;
-            return tex;
-        }
-        
-        GLenum format = GL_RGBA;
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                     0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        free(data);
-    }
-    
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    
-    CHECK_GL_ERRORS;
-    return tex;
+    return TextureLoader::get().load2D(path, wrapping);
 }
 
-/***********************************************************************************************
-                                    Uploading uniforms
- Note: all fcns below require the shader to have been enabled & the VAO to have been bound first
- ***********************************************************************************************/
-
-void Object::uploadLightingUniforms()
+// Same as above, for a texture cube map
+// Note: must set active texture unit FIRST
+GLuint Object::storeCubeMap(vector<string>& faces)
 {
-    GLint location = m_shader->getUniformLocation("LightColor");
-    glUniform3fv( location, 1, value_ptr(m_scene->sun()->color()) );
-    
-    location = m_shader->getUniformLocation("LightPosition");
-    glUniform3fv( location, 1, value_ptr(m_scene->sun()->position()) );
-    
-    location = m_shader->getUniformLocation("CameraPosition");
-    glUniform3fv(location, 1, value_ptr(m_scene->camera()->position()));
-    
-    location = m_shader->getUniformLocation("AmbientIntensity");
-    vec3 ambientIntensity(0.5f);
-    glUniform3fv(location, 1, value_ptr(ambientIntensity));
-    
-    CHECK_GL_ERRORS;
+    return TextureLoader::get().loadCubeMap(faces);
 }
 
-void Object::uploadMaterialUniforms(vec3 kd, vec3 ks, float shininess)
+// Note: the VAO must be unbound first, otherwise this would detach the VAO's element buffer
+// Note: rendering never needs this, only code which binds things without the GL state tracker
+void Object::releaseData()
 {
-    GLint location = m_shader->getUniformLocation("material.kd");
-    glUniform3fv(location, 1, value_ptr(kd));
+    for (int unit=0; unit<DrawPacket::MAX_TEXTURES; unit++) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    }
+    glActiveTexture(GL_TEXTURE0);
     
-    location = m_shader->getUniformLocation("material.ks");
-    glUniform3fv(location, 1, value_ptr(ks));
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
     
-    location = m_shader->getUniformLocation("material.shininess");
-    glUniform1f(location, shininess);
+    // The state tracker no longer knows what is bound
+    GLState::get().invalidate();
     
     CHECK_GL_ERRORS;
 }
 
-void Object::uploadClippingUniforms(Mode mode)
-{
-    bool clippingEnabled = mode == REFLECTION || mode == REFRACTION;
-    GLint location = m_shader->getUniformLocation("ClippingEnabled");
-    glUniform1f(location, clippingEnabled);
+/***********************************************************************************************
+                                    Uploading uniforms
+ Note: uploadCustomUniforms is called by the render queue with the shader enabled & the VAO bound
+ ***********************************************************************************************/
 
-    if (!clippingEnabled) return;
-    
-    // Define a clipping plane in the form (A, B, C, D) where A, B, C is the normal & D is the distance from the origin
-    vec4 clippingPlane;
-    if (mode == REFLECTION)
-        // Clip everything below water level
-        clippingPlane = vec4(0, 1, 0, m_scene->water()->position().y);
-    
-    else if (mode == REFRACTION)
-        // Clip everything above water level + 1 (offset is to fix water displacement problem)
-        clippingPlane = vec4(0, -1, 0, m_scene->water()->position().y + 1.0f);
-    
-    location = m_shader->getUniformLocation("ClippingPlane");
-    glUniform4fv(location, 1, value_ptr(clippingPlane));
-    
-    CHECK_GL_ERRORS;
+void Object::setMaterial(vec3 kd, vec3 ks, float shininess)
+{
+    m_kd = kd;
+    m_ks = ks;
+    m_shininess = shininess;
 }
 
 mat4 Object::modelMatrix()
@@ -234,33 +155,13 @@ mat4 Object::modelMatrix()
     return model;
 }
 
-void Object::uploadModelUniform()
-{
-    mat4 model = modelMatrix();
-    GLint location = m_shader->getUniformLocation("Model");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(model));
-    
-    CHECK_GL_ERRORS;
-}
-
-void Object::uploadViewUniform()
-{
-    mat4 view = m_scene->camera()->viewMatrix();
-    
-    GLint location = m_shader->getUniformLocation("View");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(view));
-    
-    CHECK_GL_ERRORS;
-}
-
-void Object::uploadProjectionUniform()
+ObjectUniforms Object::objectUniforms(Mode m)
 {
-    mat4 projection = m_scene->camera()->projMatrix();
-    
-    GLint location = m_shader->getUniformLocation("Projection");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(projection));
-    
-    CHECK_GL_ERRORS;
+    ObjectUniforms data;
+    data.model = modelMatrix();
+    data.materialKd = vec4(m_kd, 0.0f);
+    data.materialKs = vec4(m_ks, m_shininess);
+    return data;
 }
 
 void Object::uploadCustomUniforms(Mode m)
@@ -268,17 +169,7 @@ void Object::uploadCustomUniforms(Mode m)
     
 }
 
-void Object::bindData()
-{
-    // must be implemented by derived classes
-}
-
-void Object::drawElements()
-{
-    // must be implemented by derived classes
-}
-
-void Object::releaseData()
+void Object::describeDraw(DrawPacket& packet)
 {
     // must be implemented by derived classes
 }
@@ -287,24 +178,21 @@ void Object::releaseData()
                         Rendering
  ***********************************************************/
 
-void Object::render(Mode m)
+void Object::submit(RenderQueue& queue, Mode m)
 {
-    // Bind the object's vertex data
-    glBindVertexArray(m_vao);
-    m_shader->enable();
+    // Skip objects which are outside of the pass' view
+    AABB box;
+    if (worldBounds(box) && !queue.isVisible(box)) return;
     
-    // Upload all the uniforms we need
-    uploadLightingUniforms();
-    uploadModelUniform();
-    uploadViewUniform();
-    uploadProjectionUniform();
-    uploadClippingUniforms(m);
-    uploadCustomUniforms(m);
+    DrawPacket packet;
+    packet.object = this;
+    packet.shader = m_shader;
+    packet.vao = m_vao;     // Note: the VAO also remembers the element buffer
     
-    bindData();
-    drawElements();
-    releaseData();
+    // The uniforms which are specific to this object get uploaded by the queue along with
+    // everyone else's, once the whole pass has been submitted
+    packet.uniforms = objectUniforms(m);
+    describeDraw(packet);
     
-    m_shader->disable();
-    glBindVertexArray(0);
+    submitDraws(queue, packet);
 }
@@ -2,14 +2,16 @@
 
 #define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
 
-#include "cs488-framework/ShaderProgram.hpp"
+#include "Shader.hpp"
+#include "FrameContext.hpp"
+#include "RenderQueue.hpp"
+#include "ModelAsset.hpp"
+#include "CookedModel.hpp"
 #include "cs488-framework/GlErrorCheck.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/io.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -24,11 +26,13 @@ class Model;
  ***********************************************************/
 
 class Object : public Renderable {
+    friend class RenderQueue;   // calls uploadCustomUniforms right before drawing
+    
 protected:
     // Pointer to the scene in order to access the camera, light source, terrain, etc
     Scene* m_scene;
     
-    ShaderProgram* m_shader;
+    Shader* m_shader;
     GLuint m_vao;
     GLuint m_vbo;
     GLuint m_ebo;
@@ -38,32 +42,41 @@ protected:
     float m_size;
     glm::vec3 m_rotation;  // in degrees, angle per axis
     
+    // Material properties (uploaded as part of the per-object uniform block)
+    glm::vec3 m_kd;
+    glm::vec3 m_ks;
+    float m_shininess;
+    
     // Helpers for binding data to buffers
-    GLuint storeToVBO(GLfloat* vertices, int size);
-    GLuint storeToVBO(GLfloat* positions, int sizeP, GLfloat* normals, int sizeN, GLfloat* texCoords, int sizeT);
-    GLuint storeToEBO(GLuint* indices, int size);
-    GLuint storeTex(std::string path, GLenum wrapping = GL_REPEAT);
-    GLuint storeCubeMap(std::vector<std::string>& faces);
+    static GLuint storeToVBO(const void* vertices, int size);
+    static GLuint storeToVBO(const void* positions, int sizeP, const void* normals, int sizeN, const void* texCoords, int sizeT);
+    static GLuint storeToEBO(GLuint* indices, int size);
+    static GLuint storeToEBO(GLushort* indices, int size);
+    static GLuint storeTex(std::string path, GLenum wrapping = GL_REPEAT);
+    static GLuint storeCubeMap(std::vector<std::string>& faces);
+    
+    void setMaterial(glm::vec3 kd, glm::vec3 ks, float shininess);
+    void releaseData(); // unbinds the buffers & textures left bound by the constructors
     
     // Template method pattern: the following helper functions can be overridden
     // by derived classes to customize the rendering of the objects
-    virtual void uploadLightingUniforms();
-    virtual void uploadMaterialUniforms(glm::vec3 kd, glm::vec3 ks, float shininess);
-    virtual void uploadModelUniform();
-    virtual void uploadViewUniform();
-    virtual void uploadProjectionUniform();
-    virtual void uploadClippingUniforms(Mode m);
-    virtual void uploadCustomUniforms(Mode m);
-    virtual void bindData();
-    virtual void drawElements();
-    virtual void releaseData();
+    // Note: lighting, view, projection & clipping uniforms are shared by all objects in a pass
+    //       & are published once per pass by the scene's FrameContext
+    virtual ObjectUniforms objectUniforms(Mode m);          // called when the object is submitted
+    virtual void describeDraw(DrawPacket& packet);          // textures, draw call & render state
+    virtual void uploadCustomUniforms(Mode m);              // called right before the draw call
+    virtual bool worldBounds(AABB&) { return false; };      // objects without bounds are never culled
+    
+    // Called with the packet once it has been described - objects which are made up of several
+    // draws (ie. the terrain's chunks) can submit any number of variations of it instead
+    virtual void submitDraws(RenderQueue& queue, DrawPacket& packet) { queue.submit(packet); };
     
 public:
-    Object(ShaderProgram* shader, Scene* scene);
+    Object(Shader* shader, Scene* scene);
     virtual ~Object();
     
-    void render(Mode m) final;
-    virtual void renderToShadowMap() {};
+    void submit(RenderQueue& queue, Mode m) final;
+    virtual void submitToShadowMap(RenderQueue&) {};
     
     virtual glm::vec3 position()    { return m_position; }; // virtual bc Sun overrides it
     virtual glm::mat4 modelMatrix();                        // public bc Character accesses it
@@ -81,19 +94,15 @@ public:
 class Skybox : public Object {
     float m_rotationSpeed;    // degrees per second
     bool m_isDay;
+    float m_blendFactor;      // 0 = day texture, 1 = night texture
     
     // Overridden template methods
-    void uploadLightingUniforms() override;
-    void uploadModelUniform() override;
-    void uploadViewUniform() override;
-    void uploadClippingUniforms(Mode m) override;
+    ObjectUniforms objectUniforms(Mode m) override;
+    void describeDraw(DrawPacket& packet) override;
     void uploadCustomUniforms(Mode m) override;
-    void bindData() override;
-    void drawElements() override;
-    void releaseData() override;
     
 public:
-    Skybox(ShaderProgram* shader, Scene* scene, float rotateSpeed);
+    Skybox(Shader* shader, Scene* scene, float rotateSpeed);
     
     void setRotationSpeed(float r) { m_rotationSpeed = r; };
     
@@ -110,15 +119,11 @@ class Water : public Object {
     Mode m_renderingMode;
     
     // Overridden template methods
-    void uploadLightingUniforms() override;
-    void uploadClippingUniforms(Mode m) override;
+    void describeDraw(DrawPacket& packet) override;
     void uploadCustomUniforms(Mode m) override;
-    void bindData() override;
-    void drawElements() override;
-    void releaseData() override;
     
 public:
-    Water(ShaderProgram* shader, Scene* scene);
+    Water(Shader* shader, Scene* scene);
     
     void setDistortion(float d) { m_distortion = d; };
     void setBumpMapping(bool b) { m_bumpMapping = b; };
@@ -127,31 +132,81 @@ public:
 
 // ------------------------------
 
+// The terrain is split up into chunks which each pick their own level of detail in every pass
 class Terrain : public Object {
+    static const int CHUNK_QUADS = 32;                          // squares along each side of a chunk
+    static const int CHUNK_VERTICES = CHUNK_QUADS + 1;          // vertices along each side of a chunk
+    static const int VERTICES_PER_CHUNK = CHUNK_VERTICES * (CHUNK_VERTICES + 4);    // grid + 4 skirts
+    static const int NUM_LODS = 6;                              // level n uses every 2^n-th vertex
+    
+    struct Chunk {
+        GLint baseVertex;               // first vertex of the chunk in the vertex buffer
+        glm::vec3 minBounds;            // in model space
+        glm::vec3 maxBounds;
+        float error[NUM_LODS];          // geometric error of each level of detail, in world units
+    };
+    
+    // Range of the element buffer which holds the indices of a level of detail (shared by all chunks)
+    struct Level {
+        GLintptr offset;
+        GLsizei count;
+    };
+    
     float m_size;       // size of one side of the terrain square
     float m_maxHeight;  // height of the peaks
     int m_texture;
-    int m_numIndices;
     unsigned m_heightMapSize;
     
+    std::vector<Chunk> m_chunks;
+    Level m_levels[NUM_LODS];
+    Quantization m_quantization;    // of the vertices of every chunk
+    float m_lodTolerance;   // largest error allowed on screen, in pixels
+    
+    // Statistics of the last regular pass
+    int m_chunksDrawn;
+    int m_trianglesDrawn;
+    
     // Calculate these at initialization
     std::vector< std::vector<float> > m_heights;
     std::vector< std::vector<glm::vec3> > m_normals;
     
+    // The geometry made by build(), until upload() hands it over to the GPU
+    struct Staging {
+        std::vector<GLushort> indices;
+        std::vector<TerrainVertex> vertices;
+        std::vector<GLshort> positions;         // only used by TERRAIN_PLANAR_VERTICES (see Terrain.cpp)
+        std::vector<GLshort> normals;
+        std::vector<GLushort> textureCoords;
+    };
+    Staging m_staging;
+    
     void calculateHeightsAndNormals(unsigned char* heightMap);
+    float heightAt(int i, int j);
+    float chunkError(int i0, int j0, int step);
     float baryCentric(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, glm::vec2 pos);
     
     // Overridden template methods
-    void uploadCustomUniforms(Mode m) override;
-    void bindData() override;
-    void drawElements() override;
-    void releaseData() override;
+    ObjectUniforms objectUniforms(Mode m) override;
+    void describeDraw(DrawPacket& packet) override;
+    void submitDraws(RenderQueue& queue, DrawPacket& packet) override;
 
 public:
-    Terrain(ShaderProgram* shader, Scene* scene, float size, float maxHeight);
+    // Note: the terrain is empty until it has been built & uploaded
+    Terrain(Shader* shader, Scene* scene, float size, float maxHeight);
+    
+    // Decodes the height map & generates the geometry of every chunk - doesn't touch OpenGL, so it can
+    // run on a worker thread (see LoadingPipeline)
+    void build();
+    
+    // Creates the terrain's buffers & textures out of what build() made (on the main thread)
+    void upload();
     
     float getHeightAt(float x, float z);
     float getSize() { return m_size; };
+    
+    void setLodTolerance(float pixels)  { m_lodTolerance = pixels; };
+    int chunksDrawn()                   { return m_chunksDrawn; };
+    int trianglesDrawn()                { return m_trianglesDrawn; };
 };
 
 // ------------------------------
@@ -163,93 +218,69 @@ class Sun : public Object {
     glm::vec3 m_directionToSun;
     float m_dist;
     
-    // Shadow map clipping planes
-    float m_left;
-    float m_right;
-    float m_top;
-    float m_bottom;
-    float m_near;
-    float m_far;
+    // Occlusion queries are read back a couple of frames late so that we never wait on the GPU,
+    // which means that a few of them are in flight at any given time
+    static const int OCCLUSION_QUERIES = 3;
+    GLuint m_visibleQueries[OCCLUSION_QUERIES]; // samples of the sun which pass the depth test
+    GLuint m_totalQueries[OCCLUSION_QUERIES];   // samples of the sun, occluded or not
+    bool m_queryPending[OCCLUSION_QUERIES];
+    int m_nextQuery;
+    float m_visibility;
     
     void updateDirectionToSun();
-    void updateClippingPlanes();
-    glm::vec3 clippingBoxCenter();
+    void readOcclusionQueries();
   
     // Overridden template methods
-    void uploadLightingUniforms() override;
-    void uploadClippingUniforms(Mode m) override;
+    void describeDraw(DrawPacket& packet) override;
     void uploadCustomUniforms(Mode m) override;
-    void bindData() override;
-    void drawElements() override;
-    void releaseData() override;
     
 public:
-    Sun(ShaderProgram* shader, Scene* scene);
+    Sun(Shader* shader, Scene* scene);
+    ~Sun();
+    
+    // Counts how many of the sun's pixels are hidden behind the rest of the scene - must be called
+    // once everything which can occlude the sun has been drawn into the current depth buffer
+    void queryVisibility();
+    float visibility()              { return m_visibility; };  // fraction of the sun that's visible
     
     glm::vec3 color()               { return m_color; };
     glm::vec3 position() override   { return m_dist * m_directionToSun; };
     glm::mat4 modelMatrix() override;
     
-    // View & projection matrix from the Sun's perspective are for shadow mappings
-    glm::mat4 viewMatrix();
-    glm::mat4 orthographicProjMatrix();
+    // Normalized - also updates the sun's position (see ShadowCascades for the shadow mapping matrices)
+    glm::vec3 directionToSun();
 };
 
 // ------------------------------
 
-// An Image2D is a 2D GUI image which is rendered directly to the screen (2D space, not 3D space)
-class Image2D : public Object {
-    glm::vec2 m_size2D;
-    float m_transparency;
-    
-    // Overridden template methods
-    void uploadLightingUniforms() override;
-
-    void uploadViewUniform() override;
-    void uploadProjectionUniform() override;
-    void uploadClippingUniforms(Mode m) override;
-    void uploadCustomUniforms(Mode m) override;
-    void bindData() override;
-    void drawElements() override;
-    void releaseData() override;
-    
-public:
-    Image2D(ShaderProgram* shader, Scene* scene, std::string path, glm::vec2 size);
-    
-    glm::mat4 modelMatrix() override;
-    
-    void setImage(std::string path);
-    void setTransparency(float t) { m_transparency = t; };
-};
-
 // ------------------------------
 
 class Mesh : public Object {
-    friend class Model; // a container of Meshes
+    friend class Model;      // a container of Meshes
+    friend class FishSchool; // draws instances of the fish's meshes
+    friend class StaticBatch; // merges the meshes of static models
     
+    MeshAsset* m_asset;     // shared with every other instance of the same mesh
     int m_numIndices;
     
     // Overridden template methods
-    void bindData() override;
-    void drawElements() override;
-    void releaseData() override;
-    void uploadCustomUniforms(Mode m) override;
+    ObjectUniforms objectUniforms(Mode m) override;
+    void describeDraw(DrawPacket& packet) override;
+    bool worldBounds(AABB& box) override;
     
-    // Bounding box information (for collision detection)
+    // Bounding box information (for collision detection & culling)
     glm::vec3 m_minBounds;
     glm::vec3 m_maxBounds;
-    GLuint bb_vao;
-    GLuint bb_vbo;
-    ShaderProgram bb_shader;
     
-    void initBoundingBoxData();
-    void renderBoundingBox(Mode m);
+    void drawBoundingBox(glm::vec4 colour);     // through DebugDraw
     
 public:
-    Mesh(ShaderProgram* shader, Scene* scene, aiMesh* mesh, const aiScene* aiscene, std::string texturePrefix);
+    Mesh(Shader* shader, Scene* scene, MeshAsset* asset);
     ~Mesh();
     
-    void renderToShadowMap() final;
+    static MeshAsset* createAsset(const CookedMesh& mesh, std::string texturePrefix);
+    
+    void submitToShadowMap(RenderQueue& queue) final;
     
     bool collision(Mesh* m); // checks if the bounding boxes of these meshes collide
     
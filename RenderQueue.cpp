@@ -0,0 +1,140 @@
+#include "RenderQueue.hpp"
+#include "Object.hpp"
+#include "Scene.hpp"
+#include "GLState.hpp"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+using namespace glm;
+
+DrawPacket::DrawPacket() : object(nullptr), shader(nullptr), vao(0), numTextures(0),
+    primitive(GL_TRIANGLES), count(0), indexType(GL_NONE), first(0), instances(0), baseVertex(0),
+    layer(LAYER_OPAQUE), blend(BLEND_ALPHA), depthWrite(true)
+{
+    
+}
+
+void DrawPacket::addTexture(GLenum target, GLuint id)
+{
+    // Textures are added in texture unit order
+    assert(numTextures < MAX_TEXTURES);
+    textures[numTextures].target = target;
+    textures[numTextures].id = id;
+    numTextures++;
+}
+
+RenderQueue::RenderQueue(Scene* scene) : m_scene(scene)
+{
+    resetStats();
+}
+
+bool RenderQueue::isVisible(const AABB& box)
+{
+    bool visible = m_scene->frame()->frustum().intersects(box);
+    if (visible)    m_visible++;
+    else            m_culled++;
+    return visible;
+}
+
+/*
+ The sort key is laid out so that the most expensive state changes are the most significant bits:
+ 
+    | 63 - 60 | 59 - 48 | 47 - 32   | 31 - 16 | 15 - 0   |
+    |  layer  | program | texture 0 |   VAO   | sequence |
+ 
+ Only the opaque layer gets sorted by state - every other layer relies on being drawn in the order it
+ was submitted in (ie. the skybox before the sun, or the water before the images on top of it), so for
+ those layers the sequence number takes up all of the low bits
+ */
+uint64_t RenderQueue::sortKey(const DrawPacket& p, uint32_t sequence)
+{
+    uint64_t key = (uint64_t) p.layer << 60;
+    
+    if (p.layer == LAYER_OPAQUE) {
+        uint64_t program = p.shader->getProgramObject() & 0xFFF;
+        uint64_t texture = (p.numTextures > 0) ? (p.textures[0].id & 0xFFFF) : 0;
+        key |= program << 48;
+        key |= texture << 32;
+        key |= (uint64_t) (p.vao & 0xFFFF) << 16;
+        key |= sequence & 0xFFFF;
+    }
+    else {
+        key |= sequence;
+    }
+    
+    return key;
+}
+
+void RenderQueue::submit(const DrawPacket& packet)
+{
+    uint32_t sequence = (uint32_t) m_packets.size();
+    m_order.push_back( make_pair(sortKey(packet, sequence), sequence) );
+    m_packets.push_back(packet);
+}
+
+void RenderQueue::execute(Mode mode)
+{
+    if (m_packets.empty()) return;
+    
+    sort(m_order.begin(), m_order.end());
+    
+    // Upload the per-object data of the entire pass in one go, in the order it will be drawn in
+    m_uniforms.clear();
+    for (auto& entry : m_order) m_uniforms.push_back(m_packets[entry.second].uniforms);
+    FrameContext* frame = m_scene->frame();
+    GLintptr offset = frame->writeObjects(m_uniforms.data(), (int) m_uniforms.size());
+    
+    // The GL state tracker takes care of skipping whatever state is already set from the
+    // previous draw call (or even from the previous pass)
+    GLState& state = GLState::get();
+    Shader* currShader = nullptr;
+    
+    for (int i=0; i<(int) m_order.size(); i++) {
+        DrawPacket& p = m_packets[m_order[i].second];
+        
+        if (p.shader != currShader) {
+            p.shader->enable();
+            currShader = p.shader;
+            m_programSwitches++;
+        }
+        
+        state.bindVertexArray(p.vao);
+        state.depthMask(p.depthWrite);
+        if (p.blend == BLEND_ADDITIVE)  state.blendFunc(GL_SRC_ALPHA, GL_ONE);
+        else                            state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        
+        for (int unit=0; unit<p.numTextures; unit++)
+            state.bindTexture(unit, p.textures[unit].target, p.textures[unit].id);
+        
+        // Shaders which don't declare the object block (ie. the 2D image shader) upload their
+        // uniforms themselves in uploadCustomUniforms
+        if (p.shader->uses(OBJECT_BLOCK))
+            frame->bindObjectAt(offset + i * frame->objectSlotSize());
+        
+        if (p.object) p.object->uploadCustomUniforms(mode);
+        
+        if (p.instances > 0) {
+            if (p.indexType == GL_NONE)
+                glDrawArraysInstanced(p.primitive, (GLint) p.first, p.count, p.instances);
+            else
+                glDrawElementsInstancedBaseVertex(p.primitive, p.count, p.indexType, (void*) p.first,
+                                                  p.instances, p.baseVertex);
+        }
+        else if (p.indexType == GL_NONE)
+            glDrawArrays(p.primitive, (GLint) p.first, p.count);
+        else if (p.baseVertex != 0)
+            glDrawElementsBaseVertex(p.primitive, p.count, p.indexType, (void*) p.first, p.baseVertex);
+        else
+            glDrawElements(p.primitive, p.count, p.indexType, (void*) p.first);
+        m_drawCalls++;
+        
+        CHECK_GL_ERRORS;
+    }
+    
+    // Note: nothing gets unbound afterwards - whoever draws next only changes what they need
+    m_packets.clear();
+    m_order.clear();
+    
+    CHECK_GL_ERRORS;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "Shader.hpp"
+#include "FrameContext.hpp"
+#include "Mode.hpp"
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+class Scene;
+class Object;
+
+// Render layers, in the order in which they are drawn
+enum RenderLayer {
+    LAYER_SKY = 0,      // skybox & sun - drawn in submission order without writing to the depth buffer
+    LAYER_OPAQUE,       // sorted by shader, then texture, then vertex array
+    LAYER_WATER,        // drawn in submission order
+    LAYER_OVERLAY       // 2D images & lens flare - drawn in submission order
+};
+
+enum BlendMode {
+    BLEND_ALPHA = 0,    // regular transparency
+    BLEND_ADDITIVE      // used by the lens flare
+};
+
+struct TextureBinding {
+    GLenum target;
+    GLuint id;
+};
+
+// Everything needed to issue a single draw call
+struct DrawPacket {
+    static const int MAX_TEXTURES = 5;
+
+    Object* object;     // owner of the draw - gets a chance to upload its custom uniforms (optional)
+    Shader* shader;
+    GLuint vao;
+
+    TextureBinding textures[MAX_TEXTURES];  // index = texture unit
+    int numTextures;
+
+    GLenum primitive;
+    GLsizei count;
+    GLenum indexType;   // GL_NONE for non-indexed draws
+    GLintptr first;     // first vertex, or byte offset into the element buffer
+    GLsizei instances;  // 0 for regular draws
+    GLint baseVertex;   // added to every index (indexed draws only)
+
+    RenderLayer layer;
+    BlendMode blend;    // only applies to the layers drawn after the opaque objects
+    bool depthWrite;
+
+    ObjectUniforms uniforms;
+
+    DrawPacket();
+    void addTexture(GLenum target, GLuint id);
+};
+
+// Collects the draw packets of a pass, sorts them with a 64 bit key & then issues them while only
+// changing the GL state which actually differs from one draw to the next
+class RenderQueue {
+    Scene* m_scene;
+
+    std::vector<DrawPacket> m_packets;
+    std::vector< std::pair<uint64_t, uint32_t> > m_order; // (sort key, packet index)
+    std::vector<ObjectUniforms> m_uniforms;               // in sorted order
+
+    // Statistics, accumulated until resetStats() is called
+    int m_drawCalls;
+    int m_programSwitches;
+    int m_visible;
+    int m_culled;
+
+    uint64_t sortKey(const DrawPacket& p, uint32_t sequence);
+
+public:
+    RenderQueue(Scene* scene);
+
+    // Frustum culling against the current pass' frustum - renderables should only submit the
+    // draws whose bounding box passes this test
+    bool isVisible(const AABB& box);
+    
+    void submit(const DrawPacket& packet);
+    void execute(Mode m);   // draws & clears everything submitted since the last execute
+
+    void resetStats()       { m_drawCalls = 0; m_programSwitches = 0; m_visible = 0; m_culled = 0; };
+    int drawCalls()         { return m_drawCalls; };
+    int programSwitches()   { return m_programSwitches; };
+    int visibleObjects()    { return m_visible; };
+    int culledObjects()     { return m_culled; };
+};
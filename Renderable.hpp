@@ -4,12 +4,19 @@
 
 #include "Mode.hpp"
 
+class RenderQueue;
+
 // Common base class for the 3 type of renderable objects we have: Objects, Models & Lens Flare 
 class Renderable {
 public:
     Renderable() {};
     virtual ~Renderable() {};
     
-    virtual void render(Mode m) = 0;
-    virtual void renderToShadowMap() = 0;
+    // Renderables don't draw themselves directly - they describe their draw calls to a render
+    // queue, which sorts them & issues them once everything for the pass has been submitted
+    virtual void submit(RenderQueue& queue, Mode m) = 0;
+    virtual void submitToShadowMap(RenderQueue& queue) = 0;
+    
+    // Static renderables never move, so their shadows get cached from one frame to the next
+    virtual bool isStatic() { return false; };
 };
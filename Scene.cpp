@@ -1,37 +1,70 @@
 #include "Scene.hpp"
+#include "GLState.hpp"
+#include "DebugDraw.hpp"
+#include <algorithm>
 
 using namespace std;
 using namespace glm;
 
-Scene::Scene(Camera* c, int w, int h, ShaderProgram* shadowShader) :
-    m_renderBoundingBoxes(false), m_camera(c), m_shadowShader(shadowShader),
-    m_reflection(w, h, true), m_refraction(w, h, true), m_shadowMap(w, h, false)
+static const int SHADOW_CASCADES = 3;       // 2-4
+static const int CASCADE_SIZE = 1024;       // width & height of each cascade, in texels
+static const float SHADOW_DISTANCE = 800.0f;
+
+/*
+ Formats of the extra framebuffers which we render to. The water only needs RGB colors, so a packed
+ float format (4 bytes per pixel) is enough; only the refraction's depth gets sampled (to figure out
+ how deep the water is), & 16 bits of depth are plenty for the cascades' orthographic projections.
+ */
+static const FrameBufferFormat REFLECTION_FORMAT = { GL_R11F_G11F_B10F, GL_DEPTH_COMPONENT24, false, 1 };
+static const FrameBufferFormat REFRACTION_FORMAT = { GL_R11F_G11F_B10F, GL_DEPTH_COMPONENT24, true, 1 };
+static const FrameBufferFormat SHADOW_MAP_FORMAT = { GL_NONE, GL_DEPTH_COMPONENT16, true, SHADOW_CASCADES };
+
+static const float WATER_SCALE = 0.5f;      // the water's distortion hides most of the lost detail
+
+// Colours of the debugging lines
+static const vec4 BOUNDING_BOX_COLOUR = vec4(1, 0, 0.5, 1);
+static const vec4 CASCADE_COLOURS[] = {     // nearest cascade first
+    vec4(1, 0, 0, 1),
+    vec4(0, 1, 0, 1),
+    vec4(0, 0, 1, 1),
+    vec4(1, 1, 0, 1),
+};
+static_assert(sizeof(CASCADE_COLOURS) / sizeof(CASCADE_COLOURS[0]) == ShadowCascades::MAX_CASCADES,
+              "CASCADE_COLOURS must have one entry per cascade");
+
+Scene::Scene(Camera* c, int w, int h, Shader* shadowShader) :
+    m_renderBoundingBoxes(false), m_renderShadowCascades(false), m_camera(c), m_shadowShader(shadowShader),
+    m_sun(nullptr), m_lensflare(nullptr), m_skybox(nullptr), m_water(nullptr), m_terrain(nullptr),
+    m_character(nullptr), m_fishSchool(nullptr), m_staticBatch(nullptr), m_sprites(nullptr), m_hud(nullptr),
+    m_cascades(SHADOW_CASCADES, CASCADE_SIZE, SHADOW_DISTANCE), m_staticShadowsDirty(true),
+    m_lastShadowInvalidation(SHADOWS_SCENE_CHANGED), m_framesSinceShadowInvalidation(0), m_windowHeight(h),
+    m_reflection(REFLECTION_FORMAT, WATER_SCALE), m_refraction(REFRACTION_FORMAT, WATER_SCALE),
+    m_staticShadowMap(SHADOW_MAP_FORMAT, CASCADE_SIZE), m_shadowMap(SHADOW_MAP_FORMAT, CASCADE_SIZE)
 {
-    // Initialize the extra framebuffers which we will render to
-    m_reflection.bind();
-        m_reflection.addTextureAttachment();
-        m_reflection.addDepthRenderBuffer();
-    m_reflection.unbind();
+    for (int i=0; i<NUM_SHADOW_INVALIDATIONS; i++) m_shadowInvalidations[i] = 0;
     
-    m_refraction.bind();
-        m_refraction.addTextureAttachment();
-        m_refraction.addDepthTextureAttachment();
-    m_refraction.unbind();
+    m_frame = new FrameContext(this);
+    m_queue = new RenderQueue(this);
     
-    m_shadowMap.bind();
-        m_shadowMap.addDepthTextureAttachment();
-    m_shadowMap.unbind();
+    // Allocate the extra framebuffers which we will render to
+    resize(w, h);
 };
 
 Scene::~Scene()
 {
     delete m_camera;
+    delete m_frame;
+    delete m_queue;
     delete m_sun;
     delete m_lensflare;
+    delete m_hud;
+    delete m_sprites;
     delete m_skybox;
     delete m_water;
     for (auto renderable : m_renderables) delete renderable;
-    for (auto img : m_images) delete img;
+    for (auto fish : m_fish) delete fish;
+    for (auto fish : m_caughtFish) delete fish;
+    if (m_staticBatch) for (auto model : m_staticModels) delete model;
 };
 
 // Setters ---------------------------------------------------------------------------------
@@ -78,24 +111,45 @@ void Scene::setCharacter(Character* c)
 void Scene::addFish(Fish* f)
 {
     m_fish.push_back(f);
+    // don't add to m_renderables because the fish school renders all of the fish at once
+};
+
+void Scene::setFishSchool(FishSchool* f)
+{
+    m_fishSchool = f;
     addRenderable(f);
 };
 
-void Scene::setCurrScore(Image2D* s)
+void Scene::setSprites(SpriteBatch* s)
 {
-    m_currScore = s;
-    addImage(s);
+    m_sprites = s;
+    // don't add to m_renderables because this needs to be rendered separately
 };
 
-void Scene::addImage(Image2D* i)
+void Scene::setHud(Hud* h)
 {
+    m_hud = h;
     // don't add to m_renderables because this needs to be rendered separately
-    m_images.push_back(i);
 };
 
 void Scene::addTerrainObject(TerrainObject* t)
 {
-    addRenderable(t);
+    m_staticModels.push_back(t);
+    addRenderable(t);   // until the static batches get built
+    m_staticShadowsDirty = true;
+}
+
+void Scene::buildStaticBatches()
+{
+    if (m_staticBatch) return;
+    m_staticBatch = new StaticBatch(this, m_staticModels);
+    
+    // Render the batches instead of the individual models
+    // Note: we still hold on to the models (& delete them at the end)
+    for (auto model : m_staticModels)
+        m_renderables.erase( find(m_renderables.begin(), m_renderables.end(), model) );
+    addRenderable(m_staticBatch);
+    m_staticShadowsDirty = true;
 }
 
 void Scene::removeFish(int id)
@@ -125,23 +179,51 @@ void Scene::reset()
     for (auto fish : m_fish)
         fish->reset();
     
-    m_currScore->setImage("Numbers/0.png");
+    m_hud->setScore(0);
 }
 
 // Rendering ---------------------------------------------------------------------------------
 
+void Scene::resize(int w, int h)
+{
+    // Nothing to draw into while the window is minimized
+    if (w <= 0 || h <= 0) return;
+    
+    m_camera->resize(w, h);
+    m_reflection.resize(w, h);
+    m_refraction.resize(w, h);
+    m_staticShadowMap.resize(w, h);
+    m_shadowMap.resize(w, h);
+    m_windowHeight = h;
+    glViewport(0, 0, w, h);
+}
+
+void Scene::setWaterScale(float scale)
+{
+    // Both targets are sampled with the same screen space coordinates, so they always match
+    m_reflection.setScale(scale);
+    m_refraction.setScale(scale);
+}
+
 void Scene::render()
 {
-    /* 1) Render the reflection, refraction, and shadow map textures to their respective framebuffers */
+    /* 1) Render the shadow map, reflection, and refraction textures to their respective framebuffers */
     m_camera->calculatePosition();  // make sure our camera's position is up to date
+    m_frame->beginFrame();          // compute the lighting & shadow state shared by every pass
+    m_queue->resetStats();
+    m_fishSchool->update();         // stream the fish's latest positions to the GPU
+    
+    // The cascades were just fit to this frame's view, so every pass needs them to be up to date
+    m_passTimers[SHADOW_MAP].begin();
+    generateShadowMap();
+    m_passTimers[SHADOW_MAP].end();
+    
     render(REFRACTION, &m_refraction);
     
     // Before rendering the reflection texture, we need to flip the camera in the Y axis about the water level
     m_camera->invertAroundWater();
     render(REFLECTION, &m_reflection);
     m_camera->revertAroundWater();    // reset the camera
-   
-    generateShadowMap();
     
     /* 2) Render result to output buffer */
     render(REGULAR, nullptr);
@@ -152,91 +234,163 @@ void Scene::render()
 void Scene::render(Mode mode, FrameBuffer* framebuffer)
 {
     if (framebuffer) framebuffer->bind();
+    m_frame->beginPass(mode, framebuffer ? framebuffer->height() : m_windowHeight);
+    m_passTimers[mode].begin();
  
+    GLState& state = GLState::get();
+    
     // Enable depth test
-    glEnable(GL_DEPTH_TEST);
+    state.setDepthTest(true);
     glDepthFunc(GL_LESS);   // accept fragment if closer to camera
     
     // Enable clipping
-    glEnable(GL_CLIP_DISTANCE0);
+    state.setClipDistance(0, true);
     
     // Enable blending to create transparency effect if a < 1
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.setBlend(true);
+    state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
-    // Clear the screen
+    // Clear the screen (the depth mask has to be on for the depth buffer to get cleared)
+    state.depthMask(true);
     glClearColor(0.529, 0.808, 0.922, 1.0);   // sky blue
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
-    // Turn off the depth mask for rendering the skybox & sun so that they always gets overwritten
-    glDepthMask(GL_FALSE);
-    m_skybox->render(REGULAR);
-    if (m_skybox->isDay()) m_sun->render(REGULAR);
-    glDepthMask(GL_TRUE);
+    // The skybox & sun don't write to the depth mask so that they always gets overwritten
+    // Note: the render queue draws them first regardless of the order they're submitted in
+    m_skybox->submit(*m_queue, REGULAR);
+    if (m_skybox->isDay()) m_sun->submit(*m_queue, REGULAR);
     
-    for (auto renderable : m_renderables) {
-        // don't render caught fish
-        if (find(m_caughtFish.begin(), m_caughtFish.end(), renderable) != m_caughtFish.end()) continue;
-        
-        renderable->render(mode);
-    }
+    // Note: caught fish are left out of the fish school, so they don't get rendered
+    for (auto renderable : m_renderables)
+        renderable->submit(*m_queue, mode);
     
     // Don't render water in reflection/refraction textures
     // Note: water rendering mode is modified in FishingGame.cpp via ImGui inputs
     if (mode == REGULAR) {
-        m_water->render(REGULAR);
+        m_water->submit(*m_queue, REGULAR);
+        
+        // The debugging lines go over the water, but under the 2D images
+        drawDebugLines();
+        DebugDraw::get().submit(*m_queue);
         
         // Render the 2D images after we render the water, that way any alpha blending in the image
         // will properly blend with the water
-//        for (auto img : m_images) img->render(REGULAR);
-        
-        // Same with the lens flare
-        if (m_skybox->isDay()) {
-            glDepthMask(GL_FALSE);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE); // Lens flare uses additive blending
-            m_lensflare->render(REGULAR);
-            glDepthMask(GL_TRUE);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        }
+        // Note: the HUD & lens flare only queue up their sprites - the sprite batch then draws all
+        //       of them at once (one draw call per blend mode)
+        m_hud->submit(*m_queue, REGULAR);
+        if (m_skybox->isDay()) m_lensflare->submit(*m_queue, REGULAR);
+        m_sprites->submit(*m_queue, REGULAR);
     }
     
-    if (m_renderBoundingBoxes) {
-        for (auto fish : m_fish)
-            fish->renderBoundingBox(mode);
-        m_character->renderBoundingBox(mode);
-    }
+    m_queue->execute(mode);
+    
+    // Now that the depth buffer holds everything which can block the sun, find out how much of
+    // it is visible - the lens flare picks the result up a frame or two later
+    if (mode == REGULAR && m_skybox->isDay()) m_sun->queryVisibility();
     
+    m_passTimers[mode].end();
     if (framebuffer) framebuffer->unbind();
     CHECK_GL_ERRORS;
 }
 
-void Scene::generateShadowMap()
+// Queues up whichever debugging lines are turned on (see DebugDraw)
+void Scene::drawDebugLines()
 {
-    m_shadowMap.bind();
-    glEnable(GL_DEPTH_TEST);
-    glClear( GL_DEPTH_BUFFER_BIT);
+    if (m_renderBoundingBoxes) {
+        for (auto fish : m_fish)
+            fish->drawBoundingBoxes(BOUNDING_BOX_COLOUR);
+        m_character->drawBoundingBoxes(BOUNDING_BOX_COLOUR);
+    }
     
-    // Generate the view & projection matrices
-    mat4 proj = m_sun->orthographicProjMatrix();
-    mat4 view = m_sun->viewMatrix();
+    // The volume each cascade's shadow map covers
+    if (m_renderShadowCascades) {
+        for (int i=0; i<m_cascades.count(); i++)
+            DebugDraw::get().frustum(m_cascades.viewProjection(i), CASCADE_COLOURS[i]);
+    }
+}
+
+static const char* SHADOW_INVALIDATION_NAMES[] = {
+    "scene changed",
+    "sun moved",
+    "cascade moved",
+};
+
+const char* Scene::shadowInvalidationName(ShadowInvalidation r)
+{
+    return SHADOW_INVALIDATION_NAMES[r];
+}
+
+// Returns a bit mask of the cascades whose cached static shadows are out of date
+int Scene::staleShadowLayers()
+{
+    int allLayers = (1 << m_cascades.count()) - 1;
+    int stale = 0;
+    ShadowInvalidation reason;
     
-    // Upload those matrices to the shader map shader
-    m_shadowShader->enable();
+    if (m_staticShadowsDirty) {
+        stale = allLayers;
+        reason = SHADOWS_SCENE_CHANGED;
+        m_staticShadowsDirty = false;
+    }
+    else if (m_cascades.lightMoved()) {
+        stale = allLayers;
+        reason = SHADOWS_SUN_MOVED;
+    }
+    else {
+        for (int i=0; i<m_cascades.count(); i++)
+            if (m_cascades.moved(i)) stale |= 1 << i;
+        reason = SHADOWS_CASCADE_MOVED;
+    }
     
-    GLint location = m_shadowShader->getUniformLocation("Projection");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(proj));
+    if (stale) {
+        m_shadowInvalidations[reason]++;
+        m_lastShadowInvalidation = reason;
+        m_framesSinceShadowInvalidation = 0;
+    } else {
+        m_framesSinceShadowInvalidation++;
+    }
+    return stale;
+}
 
-    location = m_shadowShader->getUniformLocation("View");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(view));
+void Scene::generateShadowMap()
+{
+    GLState::get().setDepthTest(true);
+    GLState::get().depthMask(true);
     
-    // Render the objects
-    for (auto renderable : m_renderables) {
-        // Don't render caught fish
-        if (find(m_caughtFish.begin(), m_caughtFish.end(), renderable) != m_caughtFish.end()) continue;
+    // A box around all of the cascades gets published as the pass' view & projection matrices (for
+    // culling) - the shadow shader's geometry shader sends each triangle to every cascade's layer
+    m_frame->beginPass(SHADOW_MAP, m_shadowMap.height());
+    
+    // Objects between the sun & the near plane of a cascade still cast shadows into it
+    glEnable(GL_DEPTH_CLAMP);
+    
+    /* 1) Re-render the static objects into the cascades of the cache which are out of date */
+    int stale = staleShadowLayers();
+    if (stale) {
+        m_staticShadowMap.bind();
+        for (int i=0; i<m_cascades.count(); i++)
+            if (stale & (1 << i)) m_staticShadowMap.clearDepthLayer(i);
         
-        renderable->renderToShadowMap();
+        m_shadowShader->enable();
+        m_shadowShader->set(Uniform::CascadeMask, stale);
+        
+        for (auto renderable : m_renderables)
+            if (renderable->isStatic()) renderable->submitToShadowMap(*m_queue);
+        m_queue->execute(SHADOW_MAP);
     }
     
-    m_shadowShader->disable();
+    /* 2) Start off with a copy of the static shadows & render everything that moves on top */
+    m_shadowMap.bind();
+    for (int i=0; i<m_cascades.count(); i++)
+        m_shadowMap.copyDepthLayer(m_staticShadowMap, i);
+    
+    m_shadowShader->enable();
+    m_shadowShader->set(Uniform::CascadeMask, (1 << m_cascades.count()) - 1);
+    
+    for (auto renderable : m_renderables)
+        if (!renderable->isStatic()) renderable->submitToShadowMap(*m_queue);
+    m_queue->execute(SHADOW_MAP);
+    
+    glDisable(GL_DEPTH_CLAMP);
     m_shadowMap.unbind();
 }
@@ -5,15 +5,33 @@
 #include "Object.hpp"
 #include "Model.hpp"
 #include "LensFlare.hpp"
+#include "SpriteBatch.hpp"
+#include "Hud.hpp"
+#include "FishSchool.hpp"
+#include "StaticBatch.hpp"
 #include "FrameBuffer.hpp"
+#include "FrameContext.hpp"
+#include "RenderQueue.hpp"
+#include "GpuTimer.hpp"
 #include "Mode.hpp"
 
+// Reasons for re-rendering the cached shadows of the static objects (see Scene::generateShadowMap)
+enum ShadowInvalidation {
+    SHADOWS_SCENE_CHANGED = 0,  // static objects were added (or this is the first frame)
+    SHADOWS_SUN_MOVED,          // the sun moved past the shadow cascades' angular threshold
+    SHADOWS_CASCADE_MOVED,      // the camera moved far enough for some of the cascades to be refit
+    NUM_SHADOW_INVALIDATIONS
+};
+
 // Container class which holds all of our objects
 class Scene {
     bool m_renderBoundingBoxes;
+    bool m_renderShadowCascades;
     
     Camera*        m_camera;
-    ShaderProgram* m_shadowShader;
+    Shader*        m_shadowShader;
+    FrameContext*  m_frame;         // per-frame & per-pass uniform state
+    RenderQueue*   m_queue;         // collects & sorts the draw calls of each pass
     
     // Objects that will be rendered
     std::vector<Renderable*> m_renderables;
@@ -27,25 +45,50 @@ class Scene {
     Character*            m_character;
     std::vector<Fish*>    m_fish;
     std::vector<Fish*>    m_caughtFish;
-    Image2D*              m_currScore;
-    std::vector<Image2D*> m_images;
+    FishSchool*           m_fishSchool;
+    std::vector<Model*>   m_staticModels;   // rendered through m_staticBatch once it has been built
+    StaticBatch*          m_staticBatch;
+    SpriteBatch*          m_sprites;        // draws the HUD & lens flare
+    Hud*                  m_hud;
 
+    // Shadows
+    ShadowCascades m_cascades;
+    bool m_staticShadowsDirty;
+    int m_shadowInvalidations[NUM_SHADOW_INVALIDATIONS];    // how many times each reason happened
+    ShadowInvalidation m_lastShadowInvalidation;
+    int m_framesSinceShadowInvalidation;
+    
     // Framebuffers
+    // Note: the reflection & refraction ("water") targets are a fraction of the window's size, which
+    //       can be adjusted while the game runs - the shadow map has a fixed size
+    int m_windowHeight;             // of the default framebuffer, in pixels
     FrameBuffer m_reflection;
     FrameBuffer m_refraction;
-    FrameBuffer m_shadowMap;
+    FrameBuffer m_staticShadowMap;  // cached shadows of the static objects
+    FrameBuffer m_shadowMap;        // the above + the shadows of everything that moves
+    
+    // How long the GPU spends on each pass (indexed by Mode - the bump map mode isn't a pass)
+    GpuTimer m_passTimers[SHADOW_MAP + 1];
     
     // Helpers
     void addRenderable(Renderable* r) { m_renderables.push_back(r); };
     void render(Mode m, FrameBuffer* framebuffer);
     void generateShadowMap();
+    int staleShadowLayers();
+    void drawDebugLines();
     
 public:
-    Scene(Camera* c, int framebufferW, int framebufferH, ShaderProgram* shadowShader);
+    Scene(Camera* c, int framebufferW, int framebufferH, Shader* shadowShader);
     ~Scene();
     
     void reset();
     void render();
+    void resize(int framebufferW, int framebufferH);    // must be called whenever the window changes size
+    
+    void setWaterScale(float scale);
+    float waterScale()                { return m_reflection.scale(); };
+    int waterWidth()                  { return m_reflection.width(); };
+    int waterHeight()                 { return m_reflection.height(); };
     
     // Setters
     void setSun(Sun* s);
@@ -55,29 +98,47 @@ public:
     void setTerrain(Terrain* t);
     void setCharacter(Character* c);
     void addFish(Fish* f);
-    void setCurrScore(Image2D* s);
-    void addImage(Image2D* i); // for other images which won't get changed later
+    void setFishSchool(FishSchool* f);
+    void setSprites(SpriteBatch* s);    // must be set before the HUD & lens flare are created
+    void setHud(Hud* h);
     void addTerrainObject(TerrainObject* t);
     
+    // Must be called once all the terrain objects have been added & placed
+    void buildStaticBatches();
+    
     void renderBoundingBoxes(bool b) { m_renderBoundingBoxes = b; };
+    void renderShadowCascades(bool b) { m_renderShadowCascades = b; };
     
     // Modifiers
     void removeFish(int id);
     
     // Accessors
     Camera*             camera()      { return m_camera; };
+    FrameContext*       frame()       { return m_frame; };
+    RenderQueue*        queue()       { return m_queue; };
     Sun*                sun()         { return m_sun; };
     Skybox*             skybox()      { return m_skybox; };
     Water*              water()       { return m_water; };
     Terrain*            terrain()     { return m_terrain; };
     Character*          character()   { return m_character; };
     std::vector<Fish*>  fish()        { return m_fish; };
-    Image2D*            currScore()   { return m_currScore; };
+    SpriteBatch*        sprites()     { return m_sprites; };
+    Hud*                hud()         { return m_hud; };
     
     GLuint reflectionTexture()        { return m_reflection.texture(); };
     GLuint refractionTexture()        { return m_refraction.texture(); };
     GLuint refractionDepthTexture()   { return m_refraction.depthTexture(); };
-    GLuint shadowMapTexture()         { return m_shadowMap.depthTexture(); };
+    GLuint shadowMapTexture()         { return m_shadowMap.depthTexture(); };   // texture array, 1 layer per cascade
+    ShadowCascades* cascades()        { return &m_cascades; };
+    
+    // Shadow caching statistics
+    int shadowInvalidations(ShadowInvalidation r)   { return m_shadowInvalidations[r]; };
+    ShadowInvalidation lastShadowInvalidation()     { return m_lastShadowInvalidation; };
+    int framesSinceShadowInvalidation()             { return m_framesSinceShadowInvalidation; };
+    static const char* shadowInvalidationName(ShadowInvalidation r);
+    
+    // GPU time of the last few frames' passes, in milliseconds
+    float passTime(Mode m)                          { return m_passTimers[m].milliseconds(); };
     
-    ShaderProgram* shadowShader() { return m_shadowShader; };
+    Shader* shadowShader() { return m_shadowShader; };
 };
@@ -0,0 +1,250 @@
+#include "Shader.hpp"
+#include "GLState.hpp"
+#include "FileSystem.hpp"
+#include "ShaderCache.hpp"
+#include "cs488-framework/ShaderException.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+
+using namespace std;
+using namespace glm;
+
+// From GL_KHR_parallel_shader_compile, which isn't in our GL headers
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// The names of the uniforms in the GLSL source, in the same order as the Uniform enum
+static const char* UNIFORM_NAMES[] = {
+    "Model",
+    "View",
+    "Projection",
+
+    "DiffuseTexture",
+    "GrassTexture",
+    "DirtTexture",
+    "ShadowMap",
+
+    "ReflectionTexture",
+    "RefractionTexture",
+    "RefractionDepthTexture",
+    "wavemap.DisplacementMap",
+    "wavemap.BumpMap",
+    "Near",
+    "Far",
+    "Time",
+    "WaterDistortion",
+    "BumpMapping",
+    "Mode",
+
+    "DaySkybox",
+    "NightSkybox",
+    "BlendFactor",
+
+    "Image",
+    "Transparency",
+    
+    "CascadeMask",
+};
+static_assert(sizeof(UNIFORM_NAMES) / sizeof(UNIFORM_NAMES[0]) == (size_t) Uniform::Count,
+              "UNIFORM_NAMES must have one entry per Uniform");
+
+// The names of the uniform blocks in the GLSL source, in the same order as the UniformBlock enum
+static const char* UNIFORM_BLOCK_NAMES[] = {
+    "FrameData",
+    "PassData",
+    "ObjectData",
+};
+static_assert(sizeof(UNIFORM_BLOCK_NAMES) / sizeof(UNIFORM_BLOCK_NAMES[0]) == NUM_UNIFORM_BLOCKS,
+              "UNIFORM_BLOCK_NAMES must have one entry per UniformBlock");
+
+Shader::Shader() : ShaderProgram(), m_linked(false), m_cached(false), m_sourceHash(HASH_SEED)
+{
+    m_locations.fill(-1);
+    for (auto& value : m_values) value.valid = false;
+    m_blocks.fill(false);
+}
+
+void Shader::attach(GLenum type, const char* filePath)
+{
+    Stage stage;
+    stage.type = type;
+    stage.path = filePath;
+    stage.shader = 0;
+    m_stages.push_back(stage);
+}
+
+// What the program is saved under in the ShaderCache, ie. "Assets/Shaders/A.vs+Assets/Shaders/A.fs"
+string Shader::cacheName() const
+{
+    string name;
+    for (const Stage& stage : m_stages) name += (name.empty() ? "" : "+") + stage.path;
+    return name;
+}
+
+void Shader::link()
+{
+    generateProgramObject();
+    m_linked = false;
+
+    // Hash all of the stages' sources together, so that changing any one of them (or the stages
+    // themselves) makes for a different program
+    vector<FileView> sources(m_stages.size());
+    m_sourceHash = HASH_SEED;
+    for (size_t i=0; i<m_stages.size(); i++) {
+        if (!FileSystem::get().open(m_stages[i].path, sources[i])) {
+            for (FileView& source : sources) source.release();
+            throw ShaderException("Error -- Failed to open file: " + m_stages[i].path);
+        }
+        m_sourceHash = hashBytes(&m_stages[i].type, sizeof(GLenum), m_sourceHash);
+        m_sourceHash = hashBytes(sources[i].data, sources[i].size, m_sourceHash);
+    }
+
+    m_cached = ShaderCache::get().load(getProgramObject(), cacheName(), m_sourceHash);
+    if (!m_cached) {
+        // Hand all of the work over to the driver without asking how it went, since that would make
+        // us wait for it to be done (see finishLink)
+        // The sources are passed with their length, so they don't need to be copied into null
+        // terminated strings first
+        for (size_t i=0; i<m_stages.size(); i++) {
+            Stage& stage = m_stages[i];
+            stage.shader = glCreateShader(stage.type);
+            const GLchar* code = (const GLchar*) sources[i].data;
+            GLint length = (GLint) sources[i].size;
+            glShaderSource(stage.shader, 1, &code, &length);
+            glCompileShader(stage.shader);
+
+            // The shader only gets deleted for real once it's detached from the program
+            glAttachShader(getProgramObject(), stage.shader);
+            glDeleteShader(stage.shader);
+        }
+
+        ShaderCache::get().prepare(getProgramObject());
+        glLinkProgram(getProgramObject());
+    }
+
+    for (FileView& source : sources) source.release();
+    CHECK_GL_ERRORS;
+}
+
+bool Shader::ready()
+{
+    if (m_linked || !ShaderCache::get().parallelCompile()) return true;
+
+    GLint done;
+    glGetProgramiv(getProgramObject(), GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+// Waits for the program to be linked (if it isn't already), then resolves its uniforms
+void Shader::finishLink()
+{
+    if (m_linked) return;
+
+    GLint linked;
+    glGetProgramiv(getProgramObject(), GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        // A stage which didn't compile says a lot more about what went wrong than the link failing
+        for (Stage& stage : m_stages) {
+            GLint compiled;
+            glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &compiled);
+            if (compiled == GL_TRUE) continue;
+
+            GLint logLength;
+            glGetShaderiv(stage.shader, GL_INFO_LOG_LENGTH, &logLength);
+            string log(logLength + 1, '\0');
+            glGetShaderInfoLog(stage.shader, logLength, nullptr, &log[0]);
+            throw ShaderException("Error Compiling Shader " + stage.path + ": " + log.c_str());
+        }
+
+        GLint logLength;
+        glGetProgramiv(getProgramObject(), GL_INFO_LOG_LENGTH, &logLength);
+        string log(logLength + 1, '\0');
+        glGetProgramInfoLog(getProgramObject(), logLength, nullptr, &log[0]);
+        throw ShaderException("Error Linking Shaders " + cacheName() + ": " + log.c_str());
+    }
+    m_linked = true;
+
+    if (!m_cached) ShaderCache::get().save(getProgramObject(), cacheName(), m_sourceHash);
+
+    // The linked program doesn't need its shaders anymore
+    for (Stage& stage : m_stages) {
+        if (stage.shader) glDetachShader(getProgramObject(), stage.shader);
+        stage.shader = 0;
+    }
+
+    // Resolve every uniform once - any uniform this program doesn't use (or which the GLSL
+    // compiler optimized out) gets a location of -1, which makes setting it a no-op
+    for (int i=0; i<NUM_UNIFORMS; i++) {
+        m_locations[i] = glGetUniformLocation(getProgramObject(), UNIFORM_NAMES[i]);
+        m_values[i].valid = false;
+    }
+    
+    // Attach whichever of the shared uniform blocks this program declares to their binding points
+    // Note: this has to be done for programs loaded out of the cache too, their bindings start at 0
+    for (int i=0; i<NUM_UNIFORM_BLOCKS; i++) {
+        GLuint index = glGetUniformBlockIndex(getProgramObject(), UNIFORM_BLOCK_NAMES[i]);
+        m_blocks[i] = (index != GL_INVALID_INDEX);
+        if (m_blocks[i]) glUniformBlockBinding(getProgramObject(), index, i);
+    }
+
+    CHECK_GL_ERRORS;
+}
+
+void Shader::enable()
+{
+    finishLink();
+    GLState::get().useProgram(getProgramObject());
+}
+
+bool Shader::isCached(Uniform u, const void* data, size_t size)
+{
+    CachedValue& cached = m_values[(int) u];
+    if (cached.valid && memcmp(cached.data, data, size) == 0) return true;
+
+    memcpy(cached.data, data, size);
+    cached.valid = true;
+    return false;
+}
+
+// Setters ---------------------------------------------------------------------------------
+
+void Shader::set(Uniform u, int value)
+{
+    GLint location = m_locations[(int) u];
+    if (location == -1 || isCached(u, &value, sizeof(value))) return;
+
+    glUniform1i(location, value);
+}
+
+void Shader::set(Uniform u, float value)
+{
+    GLint location = m_locations[(int) u];
+    if (location == -1 || isCached(u, &value, sizeof(value))) return;
+
+    glUniform1f(location, value);
+}
+
+void Shader::set(Uniform u, const vec3& value)
+{
+    GLint location = m_locations[(int) u];
+    if (location == -1 || isCached(u, value_ptr(value), sizeof(value))) return;
+
+    glUniform3fv(location, 1, value_ptr(value));
+}
+
+void Shader::set(Uniform u, const vec4& value)
+{
+    GLint location = m_locations[(int) u];
+    if (location == -1 || isCached(u, value_ptr(value), sizeof(value))) return;
+
+    glUniform4fv(location, 1, value_ptr(value));
+}
+
+void Shader::set(Uniform u, const mat4& value)
+{
+    GLint location = m_locations[(int) u];
+    if (location == -1 || isCached(u, value_ptr(value), sizeof(value))) return;
+
+    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(value));
+}
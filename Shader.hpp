@@ -0,0 +1,127 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/ShaderProgram.hpp"
+#include "cs488-framework/GlErrorCheck.hpp"
+#include <glm/glm.hpp>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Every uniform which isn't part of a uniform block is interned here so that the rendering code can
+// refer to a uniform by ID instead of by name (which costs a string lookup in the driver every time)
+enum class Uniform {
+    Model,
+    View,
+    Projection,
+
+    DiffuseTexture,
+    GrassTexture,
+    DirtTexture,
+    ShadowMap,
+
+    ReflectionTexture,
+    RefractionTexture,
+    RefractionDepthTexture,
+    DisplacementMap,
+    BumpMap,
+    Near,
+    Far,
+    Time,
+    WaterDistortion,
+    BumpMapping,
+    WaterMode,
+
+    DaySkybox,
+    NightSkybox,
+    BlendFactor,
+
+    Image,
+    Transparency,
+    
+    CascadeMask,
+
+    Count
+};
+
+// Fixed binding points of the uniform blocks shared between our shaders (see FrameContext.hpp)
+enum UniformBlock {
+    FRAME_BLOCK = 0,
+    PASS_BLOCK,
+    OBJECT_BLOCK,
+    NUM_UNIFORM_BLOCKS
+};
+
+// A ShaderProgram which resolves the locations of all of its uniforms once at link time, & which
+// remembers the last value uploaded to each of them so that re-uploading the same value is free
+//
+// Linking doesn't wait for the driver: link() only starts compiling & linking the program (or loads
+// it out of the ShaderCache), & its status only gets checked the first time the shader is used - so
+// all of the shaders can compile at the same time, while the assets load
+class Shader : public ShaderProgram {
+    static const int NUM_UNIFORMS = (int) Uniform::Count;
+
+    struct CachedValue {
+        bool valid;
+        GLfloat data[16];   // large enough for a mat4
+    };
+
+    struct Stage {
+        GLenum type;
+        std::string path;
+        GLuint shader;      // 0 until it gets compiled
+    };
+
+    std::vector<Stage> m_stages;
+    bool m_linked;          // whether the link status was checked & the uniforms resolved
+    bool m_cached;          // whether the program was loaded out of the ShaderCache
+    uint64_t m_sourceHash;
+
+    std::array<GLint, NUM_UNIFORMS> m_locations;
+    std::array<CachedValue, NUM_UNIFORMS> m_values;
+    std::array<bool, NUM_UNIFORM_BLOCKS> m_blocks;  // which of the shared blocks this program declares
+
+    // Returns true if the uniform already holds this value, otherwise caches it & returns false
+    bool isCached(Uniform u, const void* data, size_t size);
+
+    void attach(GLenum type, const char* filePath);
+    std::string cacheName() const;
+    void finishLink();
+
+public:
+    Shader();
+
+    // Hide ShaderProgram's attach functions so that the GLSL source gets read through the file
+    // system (ie. straight out of the asset archive) instead of from disk
+    // Note: the stages only get compiled once the program is linked
+    void attachVertexShader(const char* filePath)   { attach(GL_VERTEX_SHADER, filePath); };
+    void attachFragmentShader(const char* filePath) { attach(GL_FRAGMENT_SHADER, filePath); };
+    void attachGeometryShader(const char* filePath) { attach(GL_GEOMETRY_SHADER, filePath); };
+
+    // Hides ShaderProgram::link: starts compiling & linking the attached stages without waiting for
+    // them (see above) - compile & link errors get thrown the first time the shader is used
+    void link();
+
+    // True once the program can be used without waiting for the driver to finish compiling it
+    // Note: without GL_KHR_parallel_shader_compile there's no way to tell, so this is always true
+    bool ready();
+
+    // Hide ShaderProgram::enable/disable so that program switches go through the GL state tracker
+    // Note: disabling is a no-op - the next program to be enabled simply replaces this one
+    void enable();
+    void disable()                  {};
+
+    bool has(Uniform u)             { finishLink(); return m_locations[(int) u] != -1; };
+    GLint location(Uniform u)       { finishLink(); return m_locations[(int) u]; };
+    bool uses(UniformBlock b)       { finishLink(); return m_blocks[b]; };
+
+    // Note: all setters require the shader to be enabled first
+    void set(Uniform u, int value);
+    void set(Uniform u, bool value) { set(u, (int) value); };
+    void set(Uniform u, float value);
+    void set(Uniform u, const glm::vec3& value);
+    void set(Uniform u, const glm::vec4& value);
+    void set(Uniform u, const glm::mat4& value);
+};
@@ -0,0 +1,126 @@
+#include "ShaderCache.hpp"
+#include "CookedFile.hpp"
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+static const char MAGIC[4] = { 'P', 'R', 'O', 'G' };
+static const uint32_t VERSION = 1;  // bump whenever the layout below changes
+
+// Start of every saved program, followed by the binary itself
+struct ProgramHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t driverHash;
+    uint32_t format;        // as returned by glGetProgramBinary
+    uint32_t size;          // of the binary, in bytes
+};
+
+static bool hasExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i=0; i<count; i++)
+        if (strcmp((const char*) glGetStringi(GL_EXTENSIONS, i), name) == 0) return true;
+    return false;
+}
+
+ShaderCache& ShaderCache::get()
+{
+    static ShaderCache cache;
+    return cache;
+}
+
+ShaderCache::ShaderCache() : m_binaries(false), m_parallel(false), m_driver(HASH_SEED)
+{
+    // A binary is only good for the driver which made it
+    GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+    for (GLenum s : strings) {
+        const char* value = (const char*) glGetString(s);
+        if (value) m_driver = hashBytes(value, strlen(value) + 1, m_driver);
+    }
+
+    // Program binaries are core in GL 4.1 - on 3.3 they're up to the driver (ARB_get_program_binary),
+    // & a driver may well support them without any binary format to hand out
+    GLint formats = 0;
+#ifndef __APPLE__
+    if (glGetProgramBinary && glProgramBinary && glProgramParameteri)
+#endif
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    while (glGetError() != GL_NO_ERROR) {}   // GL_INVALID_ENUM if the driver doesn't know about them
+    m_binaries = (formats > 0);
+
+    // Let the driver compile on as many threads as it likes (macOS has neither extension)
+#ifndef __APPLE__
+    typedef void (*MaxShaderCompilerThreads)(GLuint count);
+    MaxShaderCompilerThreads setThreads = nullptr;
+    if (hasExtension("GL_KHR_parallel_shader_compile"))
+        setThreads = (MaxShaderCompilerThreads) gl3wGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if (hasExtension("GL_ARB_parallel_shader_compile"))
+        setThreads = (MaxShaderCompilerThreads) gl3wGetProcAddress("glMaxShaderCompilerThreadsARB");
+    if (setThreads) {
+        setThreads(0xFFFFFFFF);
+        m_parallel = true;
+    }
+#endif
+}
+
+bool ShaderCache::load(GLuint program, const string& name, uint64_t sourceHash)
+{
+    if (!m_binaries) return false;
+
+    MappedFile file;
+    if (!file.open(cookedPath(name, ".prog"))) return false;
+
+    const ProgramHeader* header = (const ProgramHeader*) file.data;
+    bool valid = file.size >= sizeof(ProgramHeader) &&
+                 memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 header->version == VERSION &&
+                 header->sourceHash == sourceHash &&
+                 header->driverHash == m_driver &&
+                 file.size == sizeof(ProgramHeader) + header->size;
+
+    // Unlike glLinkProgram, loading a binary doesn't happen in the background - the link status is
+    // known right away
+    GLint linked = GL_FALSE;
+    if (valid) {
+        glProgramBinary(program, header->format, file.data + sizeof(ProgramHeader), header->size);
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    file.close();
+    return linked == GL_TRUE;
+}
+
+void ShaderCache::prepare(GLuint program)
+{
+    if (m_binaries) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ShaderCache::save(GLuint program, const string& name, uint64_t sourceHash)
+{
+    if (!m_binaries) return;
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) return;
+
+    vector<unsigned char> binary(size);
+    GLenum format;
+    glGetProgramBinary(program, size, &size, &format, binary.data());
+    if (size <= 0) return;
+
+    ProgramHeader header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.sourceHash = sourceHash;
+    header.driverHash = m_driver;
+    header.format = format;
+    header.size = (uint32_t) size;
+
+    writeCookedFile(cookedPath(name, ".prog"), {
+        { &header, sizeof(header) },
+        { binary.data(), (size_t) size },
+    });
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/OpenGLImport.hpp"
+#include <string>
+#include <cstdint>
+
+/*
+ Saves every linked shader program to COOKED_DIRECTORY (see CookedFile.hpp) with glGetProgramBinary,
+ so that later launches can load it back with glProgramBinary instead of compiling & linking the
+ GLSL all over again.
+
+ A saved program is only used if it was made out of the exact same GLSL (its hash is in the file)
+ by the exact same driver (the vendor, renderer & version strings are hashed in too). The driver can
+ still reject a binary (most drivers do after an update), in which case the program simply gets
+ compiled from its source again & the binary overwritten.
+ */
+class ShaderCache {
+    bool m_binaries;        // the driver can hand out program binaries
+    bool m_parallel;        // GL_KHR_parallel_shader_compile (or the ARB version of it)
+    uint64_t m_driver;      // hash of the driver's strings
+
+    ShaderCache();
+
+public:
+    static ShaderCache& get();
+
+    // Loads the binary saved for this program (named after its source files) into it - returns false
+    // if there is none, if it's out of date, or if the driver wouldn't take it
+    bool load(GLuint program, const std::string& name, uint64_t sourceHash);
+
+    // Must be called before linking a program which is going to be saved, so that the driver holds
+    // on to its binary
+    void prepare(GLuint program);
+
+    // Saves the binary of a program which just linked successfully
+    void save(GLuint program, const std::string& name, uint64_t sourceHash);
+
+    // Whether programs can be asked if they're done compiling & linking without waiting for them
+    // (GL_COMPLETION_STATUS_KHR) - otherwise, the first query of their status blocks until they are
+    bool parallelCompile() const    { return m_parallel; };
+};
@@ -0,0 +1,112 @@
+#include "ShadowCascades.hpp"
+#include "Camera.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace glm;
+
+static const float SPLIT_LAMBDA = 0.5f;     // 0 = evenly spaced slices, 1 = logarithmically spaced
+static const float FIRST_SPLIT_NEAR = 1.0f; // nothing gets this close to the camera anyway
+static const float PADDING = 1.25f;         // cascades cover a bit more than their slice (see below)
+static const float CASTER_RANGE = 500.0f;   // how far towards the sun objects can cast into a cascade
+static const float SUN_THRESHOLD = 0.25f;   // in degrees - see update()
+
+ShadowCascades::ShadowCascades(int count, int resolution, float shadowDistance) :
+    m_count(std::min(std::max(count, 1), MAX_CASCADES)), m_resolution(resolution),
+    m_shadowDistance(shadowDistance), m_lightDirection(0.0f), m_lightMoved(false), m_lightView(1.0f),
+    m_coverProj(1.0f), m_refits(0)
+{
+    for (int i=0; i<MAX_CASCADES; i++) {
+        m_cascades[i].valid = false;
+        m_cascades[i].moved = false;
+        m_cascades[i].projection = mat4(1.0f);
+        m_cascades[i].splitDistance = 0.0f;
+    }
+}
+
+void ShadowCascades::update(Camera* camera, vec3 directionToSun)
+{
+    /*
+     The sun moves very slowly, but every little bit it moves changes the whole shadow map. So the
+     shadows keep using the same direction until the sun is more than SUN_THRESHOLD degrees away
+     from it - that way the shadows of static objects can be cached in between (see Scene).
+     */
+    float cosThreshold = std::cos(radians(SUN_THRESHOLD));
+    m_lightMoved = (m_lightDirection == vec3(0.0f) || dot(directionToSun, m_lightDirection) < cosThreshold);
+    if (m_lightMoved) m_lightDirection = directionToSun;
+    
+    // The light looks towards the scene from the sun - only its rotation matters for an ortho projection
+    m_lightView = lookAt(vec3(0.0f), -m_lightDirection, vec3(0, 1, 0));
+    m_refits = 0;
+    
+    mat4 proj = camera->projMatrix();
+    mat4 toWorld = inverse(camera->viewMatrix());
+    float tanX = 1.0f / proj[0][0];     // half the width of the view at a distance of 1
+    float tanY = 1.0f / proj[1][1];
+    
+    vec3 coverMin(0.0f), coverMax(0.0f);
+    float sliceNear = std::max(camera->near(), FIRST_SPLIT_NEAR);
+    
+    for (int i=0; i<m_count; i++) {
+        Cascade& cascade = m_cascades[i];
+        
+        /* 1) Slice up the view frustum: a mix of evenly spaced & logarithmic splits */
+        float t = (float) (i + 1) / m_count;
+        float uniform = FIRST_SPLIT_NEAR + (m_shadowDistance - FIRST_SPLIT_NEAR) * t;
+        float logarithmic = FIRST_SPLIT_NEAR * std::pow(m_shadowDistance / FIRST_SPLIT_NEAR, t);
+        float sliceFar = SPLIT_LAMBDA * logarithmic + (1.0f - SPLIT_LAMBDA) * uniform;
+        cascade.splitDistance = sliceFar;
+        
+        /* 2) Find the bounding sphere of the slice */
+        // A sphere doesn't change size when the camera turns, so neither do the cascade's texels
+        vec3 corners[8];
+        vec3 center(0.0f);
+        for (int c=0; c<8; c++) {
+            float d = (c & 4) ? sliceFar : sliceNear;
+            vec3 viewSpace(((c & 1) ? 1.0f : -1.0f) * d * tanX, ((c & 2) ? 1.0f : -1.0f) * d * tanY, -d);
+            corners[c] = vec3(toWorld * vec4(viewSpace, 1.0f));
+            center += corners[c] / 8.0f;
+        }
+        float radius = 0.0f;
+        for (int c=0; c<8; c++) radius = std::max(radius, length(corners[c] - center));
+        radius = std::ceil(radius);
+        
+        /*
+         3) "Sticky" fitting: each cascade covers a slightly larger sphere than its slice, & only
+            moves once the slice pokes out of it. While it stays put, its shadows can't shimmer as
+            the camera moves (& its contents could be reused from one frame to the next).
+         */
+        bool contained = cascade.valid && length(center - cascade.center) + radius <= cascade.radius;
+        cascade.moved = !contained;
+        if (!contained) {
+            cascade.center = center;
+            cascade.radius = radius * PADDING;
+            cascade.valid = true;
+            m_refits++;
+        }
+        
+        /* 4) Snap the cascade to whole texels of the shadow map */
+        // Otherwise the texels would land on different spots of the scene every time the cascade
+        // moves, making the edges of the shadows crawl
+        float r = cascade.radius;
+        float texelSize = 2.0f * r / m_resolution;
+        vec3 lightSpace = vec3(m_lightView * vec4(cascade.center, 1.0f));
+        lightSpace.x = std::floor(lightSpace.x / texelSize) * texelSize;
+        lightSpace.y = std::floor(lightSpace.y / texelSize) * texelSize;
+        
+        // Note: the light looks down -Z, so distances along its view are -z
+        vec3 boxMin(lightSpace.x - r, lightSpace.y - r, -lightSpace.z - r - CASTER_RANGE);
+        vec3 boxMax(lightSpace.x + r, lightSpace.y + r, -lightSpace.z + r);
+        cascade.projection = ortho(boxMin.x, boxMax.x, boxMin.y, boxMax.y, boxMin.z, boxMax.z);
+        
+        coverMin = (i == 0) ? boxMin : glm::min(coverMin, boxMin);
+        coverMax = (i == 0) ? boxMax : glm::max(coverMax, boxMax);
+        
+        sliceNear = sliceFar;
+    }
+    
+    // Used to cull the shadow pass (which renders every cascade at once)
+    m_coverProj = ortho(coverMin.x, coverMax.x, coverMin.y, coverMax.y, coverMin.z, coverMax.z);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include <glm/glm.hpp>
+
+class Camera;
+
+/*
+ Cascaded shadow maps: the part of the camera's view frustum which receives shadows is cut into
+ slices along the view direction, & each slice gets its own orthographic projection from the sun
+ (a "cascade"). Nearby slices are small, so their shadow map texels are small too - far away ones
+ cover a lot of ground with the same number of texels.
+ 
+ Every cascade is rendered into its own layer of one depth texture array.
+ */
+class ShadowCascades {
+public:
+    static const int MAX_CASCADES = 4;  // must match the size of the arrays in the FrameData block
+    
+private:
+    struct Cascade {
+        glm::vec3 center;       // of the region covered by the cascade, in world space
+        float radius;
+        bool valid;             // false until the cascade has been fit for the first time
+        bool moved;             // during the last update (ie. what was rendered into it is out of date)
+        
+        glm::mat4 projection;
+        float splitDistance;    // distance from the camera at which the next cascade takes over
+    };
+    
+    int m_count;
+    int m_resolution;           // of each cascade, in texels
+    float m_shadowDistance;     // nothing further away than this from the camera receives shadows
+    
+    Cascade m_cascades[MAX_CASCADES];
+    glm::vec3 m_lightDirection; // only follows the sun once it has moved past a threshold
+    bool m_lightMoved;          // during the last update
+    glm::mat4 m_lightView;      // rotation only - the same for every cascade
+    glm::mat4 m_coverProj;      // covers every cascade at once
+    int m_refits;               // number of cascades which moved during the last update
+    
+public:
+    ShadowCascades(int count, int resolution, float shadowDistance);
+    
+    // Fits the cascades to the camera's current view - must be called once per frame
+    void update(Camera* camera, glm::vec3 directionToSun);
+    
+    int count()                         { return m_count; };
+    int resolution()                    { return m_resolution; };
+    int refits()                        { return m_refits; };
+    bool lightMoved()                   { return m_lightMoved; };
+    bool moved(int i)                   { return m_lightMoved || m_cascades[i].moved; };
+    glm::mat4 lightView()               { return m_lightView; };
+    glm::mat4 coverProjection()         { return m_coverProj; };
+    glm::mat4 viewProjection(int i)     { return m_cascades[i].projection * m_lightView; };
+    float splitDistance(int i)          { return m_cascades[i].splitDistance; };
+};
@@ -5,7 +5,7 @@
 using namespace std;
 using namespace glm;
 
-Skybox::Skybox(ShaderProgram* shader, Scene* scene, float speed) : Object(shader, scene), m_rotationSpeed(speed), m_isDay(true)
+Skybox::Skybox(Shader* shader, Scene* scene, float speed) : Object(shader, scene), m_rotationSpeed(speed), m_isDay(true), m_blendFactor(0.0f)
 {
     // VAO is already bound
     m_shader->enable();
@@ -23,7 +23,7 @@ Skybox::Skybox(ShaderProgram* shader, Scene* scene, float speed) : Object(shader
     };
     m_vbo = storeToVBO(points, sizeof(points));
     
-    GLuint indices[] = {
+    GLushort indices[] = {
         5, 7, 3,
         3, 1, 5,
         
@@ -75,99 +75,57 @@ Skybox::Skybox(ShaderProgram* shader, Scene* scene, float speed) : Object(shader
     glEnableVertexAttribArray(location);
 
     //      2) The first samplerCube uniform
-    location = m_shader->getUniformLocation("DaySkybox");
-    glUniform1i(location, 0);   // texture unit 0
+    m_shader->set(Uniform::DaySkybox, 0);     // texture unit 0
     
     //      3) The second samplerCube uniform
-    location = m_shader->getUniformLocation("NightSkybox");
-    glUniform1i(location, 1);   // texture unit 1
+    m_shader->set(Uniform::NightSkybox, 1);   // texture unit 1
     
     m_shader->disable();
     glBindVertexArray(0);
     releaseData();
 }
 
-void Skybox::uploadLightingUniforms()
-{
-    // No-op, no lighting needed for skybox
-}
-
-void Skybox::uploadModelUniform()
+ObjectUniforms Skybox::objectUniforms(Mode m)
 {
     // Increase the rotation
     float FPS = 60.0f; // currently hard programmed
     m_rotation.y = m_rotation.y - m_rotationSpeed / FPS;
     
-    // Call the base class version to finish the job
-    Object::uploadModelUniform();
-}
-
-void Skybox::uploadViewUniform()
-{
-    // Remove the translation component of the view matrix
-    mat4 view = mat4(mat3(m_scene->camera()->viewMatrix()));
-    GLint location = m_shader->getUniformLocation("View");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(view));
-    
-    CHECK_GL_ERRORS;
-}
-
-void Skybox::uploadClippingUniforms(Mode m)
-{
-    // skybox shader doesn't take clipping uniforms
-}
-
-void Skybox::uploadCustomUniforms(Mode m)
-{
-    // Determine & upload the blend factor uniform
-    float blendFactor = (m_isDay) ? 0.0f : 1.0f;    
+    // Determine the blend factor now, since the day/night switch needs to happen before anything
+    // else in the scene asks the skybox what time it is
+    m_blendFactor = (m_isDay) ? 0.0f : 1.0f;
     if (m_rotation.y < -360) {        // After 1 rotation: switch completely to the next texture
         m_isDay = !m_isDay;
-        blendFactor = (m_isDay) ? 0.0f : 1.0f;
+        m_blendFactor = (m_isDay) ? 0.0f : 1.0f;
         m_rotation.y += 360;
     }
     else if (m_rotation.y < -270) {   // After 0.75 rotations: start blending
-        if (m_isDay)    blendFactor = 1.0f - (m_rotation.y + 360) / 90.0f;
-        else            blendFactor = (m_rotation.y + 360) / 90.0f;
+        if (m_isDay)    m_blendFactor = 1.0f - (m_rotation.y + 360) / 90.0f;
+        else            m_blendFactor = (m_rotation.y + 360) / 90.0f;
     }
     
-    GLint location = m_shader->getUniformLocation("BlendFactor");
-    glUniform1f(location, blendFactor);
-    
-    CHECK_GL_ERRORS;
-}
-
-void Skybox::bindData()
-{
-    glBindBuffer( GL_ARRAY_BUFFER, m_vbo );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_ebo );
-    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureIDs[0]);
-
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureIDs[1]);
-    
-    CHECK_GL_ERRORS;
+    // Call the base class version to finish the job
+    // Note: the translation component of the view matrix is removed in the skybox's vertex shader
+    return Object::objectUniforms(m);
 }
 
-void Skybox::releaseData()
+void Skybox::describeDraw(DrawPacket& packet)
 {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    packet.addTexture(GL_TEXTURE_CUBE_MAP, m_textureIDs[0]);   // texture unit 0
+    packet.addTexture(GL_TEXTURE_CUBE_MAP, m_textureIDs[1]);   // texture unit 1
     
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-    
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    packet.primitive = GL_TRIANGLES;
+    packet.count = 36;
+    packet.indexType = GL_UNSIGNED_SHORT;
     
-    CHECK_GL_ERRORS;
+    // Don't write to the depth buffer so that the skybox always gets drawn over
+    packet.layer = LAYER_SKY;
+    packet.depthWrite = false;
 }
 
-void Skybox::drawElements()
+void Skybox::uploadCustomUniforms(Mode m)
 {
-    glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+    m_shader->set(Uniform::BlendFactor, m_blendFactor);
     
     CHECK_GL_ERRORS;
 }
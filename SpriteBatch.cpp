@@ -0,0 +1,261 @@
+#include "SpriteBatch.hpp"
+#include "GLState.hpp"
+#include "FileSystem.hpp"
+#include "lodepng/lodepng.h"
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace glm;
+
+//#define DEBUG_PRINT
+
+/*
+ The atlas is mipmapped (the score's images get scaled down quite a bit), so the images are kept
+ apart with some transparent padding - otherwise the smaller mip levels would bleed neighbouring
+ images into each other. Each mip level halves the padding, so we stop at the level where there's
+ only one texel of it left.
+ */
+static const int ATLAS_WIDTH = 1024;
+static const int PADDING = 8;           // texels of transparency around each image
+static const int MAX_MIP_LEVEL = 3;     // log2(PADDING)
+
+static const int VERTICES_PER_SPRITE = 6;   // 2 triangles
+
+SpriteBatch::SpriteBatch(Shader* shader) :
+    m_shader(shader), m_atlas(0), m_atlasWidth(0), m_atlasHeight(0), m_capacity(0)
+{
+    // The vertex buffer gets filled in every frame, so it starts out empty
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+    // Tell OpenGL where to find/how to interpret...
+    //      1) The screen position
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    //      2) The coordinates in the atlas
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, texCoords));
+    glEnableVertexAttribArray(1);
+
+    //      3) The sprite's transparency
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, alpha));
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // The atlas always lives in texture unit 0
+    m_shader->enable();
+    m_shader->set(Uniform::Image, 0);
+
+    GLState::get().invalidate();
+    CHECK_GL_ERRORS;
+}
+
+SpriteBatch::~SpriteBatch()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteTextures(1, &m_atlas);
+}
+
+// Atlas -------------------------------------------------------------------------------------
+
+void SpriteBatch::build(const vector<string>& directories)
+{
+    struct Image {
+        string path;            // relative to Assets/
+        unsigned char* data;    // RGBA
+        unsigned width, height;
+        int x, y;               // top left corner in the atlas
+    };
+    vector<Image> images;
+
+    // 1) Load every PNG of the directories, in alphabetical order so that the atlas' layout is
+    //    always the same
+    for (const string& dir : directories) {
+        vector<string> names = FileSystem::get().list("Assets/" + dir, ".png");
+        if (names.empty()) {
+            cerr << "Error opening directory Assets/" << dir << endl;
+            continue;
+        }
+
+        for (const string& name : names) {
+            Image img;
+            img.path = dir + "/" + name;
+
+            FileView png;
+            unsigned error = 78;    // lodepng's "failed to open file for reading"
+            if (FileSystem::get().open("Assets/" + img.path, png))
+                error = lodepng_decode32(&img.data, &img.width, &img.height, png.data, png.size);
+            png.release();
+            if (error) {
+                cerr << "Error decoding Assets/" << img.path << ". " << error << ": " << lodepng_error_text(error) << endl;
+                continue;
+            }
+            images.push_back(img);
+        }
+    }
+
+    // 2) Pack them into shelves: going from the tallest image to the shortest, each image is placed
+    //    to the right of the previous one until the row is full, at which point a new row (as tall
+    //    as its first image) is started underneath
+    vector<Image*> order;
+    for (Image& img : images) order.push_back(&img);
+    sort(order.begin(), order.end(), [](const Image* a, const Image* b) { return a->height > b->height; });
+
+    m_atlasWidth = ATLAS_WIDTH;
+    for (Image* img : order)
+        while ((int) img->width + 2 * PADDING > m_atlasWidth) m_atlasWidth *= 2;
+
+    int x = 0, y = 0, shelfHeight = 0;
+    for (Image* img : order) {
+        int w = img->width + 2 * PADDING;
+        int h = img->height + 2 * PADDING;
+        if (x + w > m_atlasWidth) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        img->x = x + PADDING;
+        img->y = y + PADDING;
+        x += w;
+        shelfHeight = std::max(shelfHeight, h);
+    }
+    m_atlasHeight = std::max(y + shelfHeight, 1);
+
+    // 3) Copy the images into the atlas (the rest of it stays transparent)
+    vector<unsigned char>& pixels = m_pixels;
+    pixels.assign(m_atlasWidth * m_atlasHeight * 4, 0);
+    for (Image& img : images) {
+        for (unsigned row=0; row<img.height; row++)
+            memcpy(&pixels[((img.y + row) * m_atlasWidth + img.x) * 4], &img.data[row * img.width * 4], img.width * 4);
+        free(img.data);
+
+        Region region;
+        region.uvMin = vec2(img.x, img.y) / vec2(m_atlasWidth, m_atlasHeight);
+        region.uvMax = vec2(img.x + img.width, img.y + img.height) / vec2(m_atlasWidth, m_atlasHeight);
+        m_regionIDs[img.path] = (int) m_regions.size();
+        m_regions.push_back(region);
+    }
+}
+
+void SpriteBatch::upload()
+{
+    glGenTextures(1, &m_atlas);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_atlasWidth, m_atlasHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels.data());
+    vector<unsigned char>().swap(m_pixels);     // the GPU has its own copy now
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MAX_MIP_LEVEL);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::get().invalidate();
+
+#ifdef DEBUG_PRINT
+    cout << "Packed " << m_regions.size() << " images into a " << m_atlasWidth << "x" << m_atlasHeight << " sprite atlas" << endl;
+#endif
+    CHECK_GL_ERRORS;
+}
+
+int SpriteBatch::find(const string& path)
+{
+    auto it = m_regionIDs.find(path);
+    if (it == m_regionIDs.end()) {
+        cerr << "Sprite " << path << " is not in the atlas" << endl;
+        return -1;
+    }
+    return it->second;
+}
+
+// Rendering ---------------------------------------------------------------------------------
+
+void SpriteBatch::draw(int sprite, vec2 position, vec2 size, float alpha, BlendMode blend)
+{
+    if (sprite < 0 || alpha <= 0.0f) return;
+
+    Sprite s;
+    s.region = sprite;
+    s.position = position;
+    s.size = size;
+    s.alpha = alpha;
+    s.blend = blend;
+    m_sprites.push_back(s);
+}
+
+void SpriteBatch::addQuad(const Sprite& s)
+{
+    const Region& r = m_regions[s.region];
+
+    // The top of the image is at the top of the atlas region (images are stored top row first)
+    SpriteVertex topLeft     = { s.position + vec2(-s.size.x,  s.size.y), r.uvMin, s.alpha };
+    SpriteVertex bottomLeft  = { s.position + vec2(-s.size.x, -s.size.y), vec2(r.uvMin.x, r.uvMax.y), s.alpha };
+    SpriteVertex topRight    = { s.position + vec2( s.size.x,  s.size.y), vec2(r.uvMax.x, r.uvMin.y), s.alpha };
+    SpriteVertex bottomRight = { s.position + vec2( s.size.x, -s.size.y), r.uvMax, s.alpha };
+
+    m_vertices.push_back(topLeft);
+    m_vertices.push_back(bottomLeft);
+    m_vertices.push_back(topRight);
+    m_vertices.push_back(topRight);
+    m_vertices.push_back(bottomLeft);
+    m_vertices.push_back(bottomRight);
+}
+
+void SpriteBatch::submit(RenderQueue& queue, Mode)
+{
+    if (m_sprites.empty()) return;
+
+    // Group the sprites by blend mode (keeping the order they were drawn in within each group) so
+    // that each blend mode is one contiguous range of the vertex buffer
+    stable_sort(m_sprites.begin(), m_sprites.end(),
+                [](const Sprite& a, const Sprite& b) { return a.blend < b.blend; });
+
+    m_vertices.clear();
+    for (const Sprite& s : m_sprites) addQuad(s);
+
+    // Give the buffer fresh storage every frame so that we never have to wait on the GPU to be
+    // done with last frame's sprites
+    GLsizeiptr size = m_vertices.size() * sizeof(SpriteVertex);
+    if (size > m_capacity) m_capacity = std::max(size, 2 * m_capacity);
+    GLState::get().bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_capacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_vertices.data());
+
+    // One draw call per blend mode
+    int first = 0;
+    while (first < (int) m_sprites.size()) {
+        int last = first;
+        while (last < (int) m_sprites.size() && m_sprites[last].blend == m_sprites[first].blend) last++;
+
+        DrawPacket packet;
+        packet.shader = m_shader;
+        packet.vao = m_vao;
+        packet.addTexture(GL_TEXTURE_2D, m_atlas);  // texture unit 0
+
+        packet.primitive = GL_TRIANGLES;
+        packet.first = first * VERTICES_PER_SPRITE;
+        packet.count = (last - first) * VERTICES_PER_SPRITE;
+
+        // Sprites are drawn on top of everything else
+        packet.layer = LAYER_OVERLAY;
+        packet.blend = m_sprites[first].blend;
+        packet.depthWrite = false;
+
+        queue.submit(packet);
+        first = last;
+    }
+
+    m_sprites.clear();
+    CHECK_GL_ERRORS;
+}
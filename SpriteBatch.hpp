@@ -0,0 +1,86 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "Renderable.hpp"
+#include "RenderQueue.hpp"
+#include "Shader.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/*
+ Draws every 2D image on the screen (the HUD & the lens flare) with as few draw calls as possible:
+ all of the images are packed into a single texture atlas when the game loads, & each frame the
+ sprites which were drawn get written into one streamed vertex buffer, then rendered with one
+ draw call per blend mode.
+
+ Positions & sizes are in NDC, with the size being half of the sprite's width & height (the same
+ convention the 2D images used to have).
+ */
+class SpriteBatch : public Renderable {
+    // Part of the atlas covered by one of the images, in texture coordinates
+    struct Region {
+        glm::vec2 uvMin;    // top left
+        glm::vec2 uvMax;    // bottom right
+    };
+
+    struct Sprite {
+        int region;
+        glm::vec2 position;
+        glm::vec2 size;
+        float alpha;
+        BlendMode blend;
+    };
+
+    struct SpriteVertex {
+        glm::vec2 position;
+        glm::vec2 texCoords;
+        float alpha;
+    };
+
+    Shader* m_shader;
+
+    GLuint m_atlas;
+    int m_atlasWidth;
+    int m_atlasHeight;
+    std::vector<Region> m_regions;
+    std::unordered_map<std::string, int> m_regionIDs;  // path relative to Assets/ -> index in m_regions
+    std::vector<unsigned char> m_pixels;    // of the atlas, from build() until upload()
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLsizeiptr m_capacity;  // of m_vbo, in bytes
+
+    std::vector<Sprite> m_sprites;          // drawn since the last submit
+    std::vector<SpriteVertex> m_vertices;
+
+    void addQuad(const Sprite& s);
+
+public:
+    // Note: the atlas is empty until it has been built & uploaded
+    SpriteBatch(Shader* shader);
+    ~SpriteBatch();
+
+    // Decodes every PNG in the given directories (relative to Assets/) & packs them into the atlas -
+    // doesn't touch OpenGL, so it can run on a worker thread (see LoadingPipeline)
+    void build(const std::vector<std::string>& directories);
+
+    // Creates the atlas' texture out of what build() made (on the main thread)
+    void upload();
+
+    // Looks up an image of the atlas by its path, ie. "Numbers/0.png" (-1 if it isn't in the atlas)
+    // Note: the returned ID stays valid for the lifetime of the batch
+    int find(const std::string& path);
+
+    // Queues up a sprite for the next submit - sprites are drawn in the order they were queued in,
+    // except that all of the alpha blended ones are drawn before the additive ones
+    void draw(int sprite, glm::vec2 position, glm::vec2 size, float alpha = 1.0f, BlendMode blend = BLEND_ALPHA);
+
+    void submit(RenderQueue& queue, Mode m) final;
+    void submitToShadowMap(RenderQueue&) final {}; // noop
+
+    int atlasWidth()    { return m_atlasWidth; };
+    int atlasHeight()   { return m_atlasHeight; };
+};
@@ -0,0 +1,149 @@
+#include "StaticBatch.hpp"
+#include "Scene.hpp"
+#include "GLState.hpp"
+#include <map>
+
+using namespace std;
+using namespace glm;
+
+StaticBatch::StaticBatch(Scene* scene, const vector<Model*>& models) : Renderable(),
+    m_scene(scene), m_numIndices(0)
+{
+    // Group the meshes by the state they need to be drawn with
+    map< pair<Shader*, GLuint>, vector<Mesh*> > groups;
+    for (Model* model : models)
+        for (Mesh* mesh : model->meshes())
+            groups[ make_pair(mesh->m_shader, mesh->m_asset->texture) ].push_back(mesh);
+    
+    // Transform every mesh into world space & append it to the consolidated vertex & index data
+    vector<MeshVertex> vertices;
+    vector<GLuint> indices;
+    for (auto& group : groups) {
+        Batch batch;
+        batch.shader = group.first.first;
+        batch.texture = group.first.second;
+        batch.prototype = group.second[0];
+        batch.info.startIndex = (unsigned) indices.size();
+        
+        for (int i=0; i<(int) group.second.size(); i++) {
+            Mesh* mesh = group.second[i];
+            mat4 model = mesh->modelMatrix();
+            
+            AABB box;
+            mesh->worldBounds(box);
+            if (i == 0) batch.bounds = box;
+            else        batch.bounds.expand(box);
+            
+            mat3 normalMatrix = transpose(inverse(mat3(model)));
+            GLuint baseVertex = (GLuint) vertices.size();
+            
+            for (const MeshVertex& v : mesh->m_asset->vertices) {
+                MeshVertex world;
+                world.position = vec3(model * vec4(v.position, 1.0f));
+                world.normal = normalize(normalMatrix * v.normal);
+                world.texCoords = v.texCoords;
+                vertices.push_back(world);
+            }
+            for (GLuint index : mesh->m_asset->indices)
+                indices.push_back(baseVertex + index);
+        }
+        
+        batch.info.numIndices = (unsigned) indices.size() - batch.info.startIndex;
+        
+        if (m_batches.empty())  m_bounds = batch.bounds;
+        else                    m_bounds.expand(batch.bounds);
+        m_batches.push_back(batch);
+    }
+    m_numIndices = (int) indices.size();
+    
+    // Same compact vertex format as every other mesh (see Mesh::createAsset), quantized to the
+    // bounds of the whole batch
+    m_quantization = Quantization::fit(vertices);
+    vector<PackedVertex> packed;
+    packed.reserve(vertices.size());
+    for (const MeshVertex& v : vertices) packed.push_back(m_quantization.pack(v));
+    
+    // Upload everything into a single set of buffers
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+    
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+    
+    m_ebo = storeIndices(indices, vertices.size(), m_indexType);
+    PackedVertex::setAttributes();
+    
+    // The shadow pass reads nothing but the positions, so it gets them tightly packed
+    vector<GLshort> positions;
+    positions.reserve(packed.size() * 4);
+    for (const PackedVertex& v : packed) positions.insert(positions.end(), v.position, v.position + 4);
+    
+    glGenVertexArrays(1, &m_shadowVao);
+    glBindVertexArray(m_shadowVao);
+    
+    glGenBuffers(1, &m_positionVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_positionVbo);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(GLshort), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    
+    PackedVertex::setPositionAttribute();
+    
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GLState::get().invalidate();
+    
+    CHECK_GL_ERRORS;
+}
+
+StaticBatch::~StaticBatch()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteVertexArrays(1, &m_shadowVao);
+    glDeleteBuffers(1, &m_positionVbo);
+}
+
+void StaticBatch::submit(RenderQueue& queue, Mode m)
+{
+    for (Batch& batch : m_batches) {
+        if (!queue.isVisible(batch.bounds)) continue;
+        
+        DrawPacket packet;
+        packet.shader = batch.shader;
+        packet.vao = m_vao;
+        packet.addTexture(GL_TEXTURE_2D, batch.texture);   // texture unit 0
+        
+        // The vertices are already in world space, so only the material & flags matter
+        packet.uniforms = batch.prototype->objectUniforms(m);
+        packet.uniforms.model = mat4(1.0f);
+        packet.uniforms.dequantScale = m_quantization.scale();
+        packet.uniforms.dequantOffset = m_quantization.offset();
+        
+        packet.primitive = GL_TRIANGLES;
+        packet.count = batch.info.numIndices;
+        packet.indexType = m_indexType;
+        packet.first = batch.info.startIndex * indexSize(m_indexType);
+        
+        queue.submit(packet);
+    }
+}
+
+void StaticBatch::submitToShadowMap(RenderQueue& queue)
+{
+    if (m_numIndices == 0 || !queue.isVisible(m_bounds)) return;
+    
+    // The batches are contiguous in the index buffer, so they can all be drawn at once
+    DrawPacket packet;
+    packet.shader = m_scene->shadowShader();
+    packet.vao = m_shadowVao;
+    packet.uniforms.dequantScale = m_quantization.scale();
+    packet.uniforms.dequantOffset = m_quantization.offset();
+    
+    packet.primitive = GL_TRIANGLES;
+    packet.count = m_numIndices;
+    packet.indexType = m_indexType;
+    
+    queue.submit(packet);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/BatchInfo.hpp"
+#include "Renderable.hpp"
+#include "Model.hpp"
+#include "Frustum.hpp"
+
+/*
+ Merges the meshes of models which never move (rocks, trees, ...) into one set of buffers, with their
+ vertices already transformed into world space. Meshes which share a shader & a texture end up in the
+ same batch - a contiguous range of the index buffer - so each batch is drawn with a single draw call,
+ & the shadow map (which doesn't care about textures) draws all of them with one draw call.
+ 
+ Note: the models must be in their final position before the batch is built, & moving them afterwards
+       has no effect on what gets rendered
+ */
+class StaticBatch : public Renderable {
+    struct Batch {
+        Shader* shader;
+        GLuint texture;
+        Mesh* prototype;    // one of the meshes in the batch, for its material
+        BatchInfo info;
+        AABB bounds;        // of all the meshes in the batch
+    };
+    
+    Scene* m_scene;
+    std::vector<Batch> m_batches;
+    int m_numIndices;       // in all batches
+    AABB m_bounds;          // of all batches
+    
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ebo;
+    GLenum m_indexType;
+    Quantization m_quantization;    // of the world space vertices
+    GLuint m_shadowVao;     // position-only stream for the shadow map (see MeshAsset)
+    GLuint m_positionVbo;
+    
+public:
+    StaticBatch(Scene* scene, const std::vector<Model*>& models);
+    ~StaticBatch();
+    
+    int numBatches()    { return (int) m_batches.size(); };
+    
+    void submit(RenderQueue& queue, Mode m) final;
+    void submitToShadowMap(RenderQueue& queue) final;
+    bool isStatic() final { return true; };
+};
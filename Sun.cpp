@@ -1,12 +1,14 @@
 #include "Object.hpp"
 #include "Scene.hpp"
+#include "GLState.hpp"
 
 using namespace std;
 using namespace glm;
 
-Sun::Sun(ShaderProgram* shader, Scene* scene) : Object(shader, scene),
+Sun::Sun(Shader* shader, Scene* scene) : Object(shader, scene),
     m_color(vec3(1.0, 1.0, 1.0)), m_directionToSun(0.0f),
-    m_dist(10000.0f) // make it really far so the lighting doesn't change drastically as the character moves
+    m_dist(10000.0f), // make it really far so the lighting doesn't change drastically as the character moves
+    m_nextQuery(0), m_visibility(0.0f)
 {
     // VAO is already bound
     m_shader->enable();
@@ -31,17 +33,21 @@ Sun::Sun(ShaderProgram* shader, Scene* scene) : Object(shader, scene),
     glEnableVertexAttribArray(location);
     
     //      2) The sun texture uniform
-    location = m_shader->getUniformLocation("Image");
-    glUniform1i(location, 0);   // texture unit 0
+    m_shader->set(Uniform::Image, 0);   // texture unit 0
     
     m_shader->disable();
     glBindVertexArray(0);
     releaseData();
+    
+    glGenQueries(OCCLUSION_QUERIES, m_visibleQueries);
+    glGenQueries(OCCLUSION_QUERIES, m_totalQueries);
+    for (int i=0; i<OCCLUSION_QUERIES; i++) m_queryPending[i] = false;
 }
 
-void Sun::uploadLightingUniforms()
+Sun::~Sun()
 {
-    // no-op, no lighting needed for sun
+    glDeleteQueries(OCCLUSION_QUERIES, m_visibleQueries);
+    glDeleteQueries(OCCLUSION_QUERIES, m_totalQueries);
 }
 
 mat4 Sun::modelMatrix()
@@ -75,46 +81,96 @@ mat4 Sun::modelMatrix()
     return model;
 }
 
-void Sun::uploadClippingUniforms(Mode m)
+void Sun::describeDraw(DrawPacket& packet)
 {
-    // sun shader doesn't take clipping uniforms
+    packet.addTexture(GL_TEXTURE_2D, m_textureIDs[0]);   // texture unit 0
+    
+    packet.primitive = GL_TRIANGLE_STRIP;
+    packet.count = 4;
+    
+    // The sun is drawn right after the skybox as if it were part of it
+    packet.layer = LAYER_SKY;
+    packet.depthWrite = false;
 }
 
 void Sun::uploadCustomUniforms(Mode m)
 {
-    GLint location = m_shader->getUniformLocation("Transparency");
-    glUniform1f(location, 1.0f);
+    // The sun uses the 2D image shader, which doesn't use the shared uniform blocks
+    // (no lighting or clipping needed for the sun)
+    m_shader->set(Uniform::Model, modelMatrix());
+    m_shader->set(Uniform::View, m_scene->camera()->viewMatrix());
+    m_shader->set(Uniform::Projection, m_scene->camera()->projMatrix());
+    m_shader->set(Uniform::Transparency, 1.0f);
     
     CHECK_GL_ERRORS;
 }
 
-void Sun::bindData()
+// Occlusion ------------------------------------------------------------------------------
+
+void Sun::queryVisibility()
 {
-    glBindBuffer( GL_ARRAY_BUFFER, m_vbo );
+    readOcclusionQueries();
     
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_textureIDs[0]);
+    // If the GPU is so far behind that the oldest query still isn't done, skip a frame rather
+    // than waiting for it
+    int q = m_nextQuery;
+    if (m_queryPending[q]) return;
     
-    CHECK_GL_ERRORS;
-}
-
-void Sun::drawElements()
-{
+    GLState& state = GLState::get();
+    m_shader->enable();
+    state.bindVertexArray(m_vao);
+    state.bindTexture(0, GL_TEXTURE_2D, m_textureIDs[0]);
+    uploadCustomUniforms(REGULAR);
+    
+    // Draw the sun's quad again without touching the color or depth buffers: once against the
+    // scene's depth buffer, & once more without the depth test to know how many samples it
+    // covers in total (so that the part of the sun that's off the screen doesn't count)
+    // Note: the image shader discards the transparent corners of the texture, so only the
+    //       samples of the sun's disc get counted
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    state.depthMask(false);
+    
+    glBeginQuery(GL_SAMPLES_PASSED, m_visibleQueries[q]);
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glEndQuery(GL_SAMPLES_PASSED);
+    
+    glDepthFunc(GL_ALWAYS);
+    glBeginQuery(GL_SAMPLES_PASSED, m_totalQueries[q]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glEndQuery(GL_SAMPLES_PASSED);
+    glDepthFunc(GL_LESS);
+    
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    
+    m_queryPending[q] = true;
+    m_nextQuery = (q + 1) % OCCLUSION_QUERIES;
     
     CHECK_GL_ERRORS;
 }
 
-void Sun::releaseData()
+// Picks up the results of every query which the GPU has finished with, oldest first, so that
+// m_visibility ends up with the most recent one
+void Sun::readOcclusionQueries()
 {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
-    
-    CHECK_GL_ERRORS;
+    for (int i=0; i<OCCLUSION_QUERIES; i++) {
+        int q = (m_nextQuery + i) % OCCLUSION_QUERIES;
+        if (!m_queryPending[q]) continue;
+        
+        // Both queries were issued back to back, so the second one is always the last to finish
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(m_totalQueries[q], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;  // neither are any of the newer ones
+        
+        GLuint visible, total;
+        glGetQueryObjectuiv(m_visibleQueries[q], GL_QUERY_RESULT, &visible);
+        glGetQueryObjectuiv(m_totalQueries[q], GL_QUERY_RESULT, &total);
+        m_visibility = (total > 0) ? (float) visible / (float) total : 0.0f;
+        m_queryPending[q] = false;
+    }
 }
 
+// ------------------------------------------------------------------------------------------
+
 void Sun::updateDirectionToSun()
 {
     // We'll vary the "direction to camera" vector with time to give the effect the the sun
@@ -143,30 +199,8 @@ void Sun::updateDirectionToSun()
     m_directionToSun = normalize(m_directionToSun);
 }
 
-void Sun::updateClippingPlanes()
-{
-    // For now, we'll just hardcode a clipping box that encompasses all the objects
-    m_left = -350.0f;
-    m_right = 450.0f;
-    m_top = 200.0f;
-    m_bottom = -100.0f;
-    m_near = m_dist - 500.0f;
-    m_far = m_dist + 500.0f;
-    
-    // In the future, we'll want to update this so that the clipping planes form a MINIMAL box
-    // which covers everything the camera can see (to a reasonable distance)
-    // ----- TODO
-}
-
-mat4 Sun::viewMatrix()
+vec3 Sun::directionToSun()
 {
     updateDirectionToSun();
-    return lookAt(position(), vec3(0.0), vec3(0, 1, 0)); // look at the center of the terrain
-}
-
-mat4 Sun::orthographicProjMatrix()
-{
-    updateClippingPlanes();
-    return ortho(m_left, m_right, m_bottom, m_top, m_near, m_far);
+    return m_directionToSun;
 }
-
@@ -1,94 +1,277 @@
 #include "Object.hpp"
 #include "Scene.hpp"
+#include "MeshOptimizer.hpp"
+#include "FileSystem.hpp"
 #include <string>
+#include <algorithm>
+#include <iostream>
 #include "lodepng/lodepng.h"
 
 using namespace std;
 using namespace glm;
 
-Terrain::Terrain(ShaderProgram* shader, Scene* scene, float size, float max) : Object(shader, scene),
-    m_size(size), m_maxHeight(max)
+//#define DEBUG_PRINT
+
+// Uncomment to upload the terrain's positions, normals & texture coordinates as 3 separate arrays
+// instead of interleaved TerrainVertex's (the layout it used to have - kept around to compare the two)
+//#define TERRAIN_PLANAR_VERTICES
+
+static const float TEXTURE_REPEAT_DISTANCE = 50.0f;   // in model space units
+
+Terrain::Terrain(Shader* shader, Scene* scene, float size, float max) : Object(shader, scene),
+    m_size(size), m_maxHeight(max), m_heightMapSize(0), m_lodTolerance(2.0f), m_chunksDrawn(0), m_trianglesDrawn(0)
+{
+    // Nothing gets loaded until build() & upload() are called
+    glBindVertexArray(0);
+}
+
+void Terrain::build()
 {
-    // VAO is already bound
-    m_shader->enable();
-    
     // Load the height map image
     unsigned char* heightMap;
     unsigned height;
     string filepath = "Assets/Terrain/heightmap.png";
     
-    unsigned error = lodepng_decode32_file(&heightMap, &m_heightMapSize, &height, filepath.c_str());
+    FileView png;
+    unsigned error = 78;    // lodepng's "failed to open file for reading"
+    if (FileSystem::get().open(filepath, png))
+        error = lodepng_decode32(&heightMap, &m_heightMapSize, &height, png.data, png.size);
+    png.release();
     if (error) {
         cerr << "Error decoding heightmap. " << error << ": " << lodepng_error_text(error) << endl;
         return;
     } else if (height != m_heightMapSize) {
         cerr << "Error decoding heightmap. Mismatched width and height:" << m_heightMapSize << ", " << height << endl;
+        free(heightMap);
         return;
     }
     calculateHeightsAndNormals(heightMap);
+    free(heightMap);
+    
+    /*
+     Rather than 1 giant grid, the terrain is split up into square chunks of CHUNK_QUADS x CHUNK_QUADS
+     squares (geomipmapping). Every chunk has the same vertex layout, so the index buffers for each
+     level of detail are generated only once & shared by all of the chunks - a chunk is drawn by
+     offsetting those indices by its first vertex (glDrawElementsBaseVertex).
+     
+     Neighbouring chunks can be drawn at different levels of detail, which leaves small cracks along
+     their shared edge. To hide these, every chunk gets a "skirt": a strip of triangles hanging down
+     from each of its edges.
+     */
+    int quads = m_heightMapSize - 1;
+    int chunksPerSide = (quads + CHUNK_QUADS - 1) / CHUNK_QUADS;   // the last chunks may hang off the map
+    m_chunks.resize(chunksPerSide * chunksPerSide);
+    
+    // 1) Measure how far each level of detail strays from the actual height map
+    float maxError = 0.0f;
+    for (int ci=0; ci<chunksPerSide; ci++) {
+        for (int cj=0; cj<chunksPerSide; cj++) {
+            Chunk& chunk = m_chunks[ci * chunksPerSide + cj];
+            for (int level=0; level<NUM_LODS; level++) {
+                chunk.error[level] = chunkError(ci * CHUNK_QUADS, cj * CHUNK_QUADS, 1 << level);
+                
+                // Coarser levels should never be "more accurate" than finer ones
+                if (level > 0) chunk.error[level] = std::max(chunk.error[level], chunk.error[level-1]);
+            }
+            maxError = std::max(maxError, chunk.error[NUM_LODS-1]);
+        }
+    }
+    
+    // The worst crack is the sum of the errors on either side of it
+    float skirtDepth = std::max(2.0f * maxError, 1.0f);
+    
+    // 2) Generate the vertices of every chunk: a grid followed by the bottom of its skirt
+    // Note that the terrain has its TOP LEFT CORNER at (0,0,0)
+    int totalVtcs = (int) m_chunks.size() * VERTICES_PER_CHUNK;
+    vector<GLfloat> positions(totalVtcs * 3);
+    vector<GLfloat> normals(totalVtcs * 3);
+    vector<GLfloat> textureCoords(totalVtcs * 2);
+    
+    float sideLength = m_size / ((float) m_heightMapSize - 1);
+    
+    // "Shrink" the displayed texture so that it repeats instead of being 1 large texture
+    // and so that it always looks about the same, regardless of how large we make the terrain
+    float shrinkFactor = m_size / TEXTURE_REPEAT_DISTANCE;
     
-    // Dynamically generate a large square made up of triangles with m_heightMapSize vertices along each edge
-    // Note that the square we will generate has its TOP LEFT CORNER at (0,0,0)
-    int totalVtcs = m_heightMapSize * m_heightMapSize;
-    GLfloat* positions = new GLfloat[totalVtcs * 3];
-    GLfloat* normals = new GLfloat[totalVtcs * 3];
-    GLfloat* textureCoords = new GLfloat[totalVtcs * 2];
     int count = 0;
-    for (int i=0; i<m_heightMapSize; i++) {
-        for (int j=0; j<m_heightMapSize; j++) {
-            float sideLength = m_size / ((float) m_heightMapSize - 1);
-            
-            GLfloat x = (float) i * sideLength;
-            GLfloat z = (float) j * sideLength;
-            positions[count*3] = x;
-            positions[count*3+1] = m_heights[i][j];
-            positions[count*3+2] = z;
-            
-            vec3 norm = m_normals[i][j];
-            normals[count*3] = norm.x;
-            normals[count*3+1] = norm.y;
-            normals[count*3+2] = norm.z;
-            
-            /* Generate the texture coordinates */
+    auto addVertex = [&](int i, int j, float drop) {
+        // Vertices which hang off the map get clamped to its edge (making their triangles degenerate)
+        i = std::min(i, quads);
+        j = std::min(j, quads);
+        
+        positions[count*3] = (float) i * sideLength;
+        positions[count*3+1] = m_heights[i][j] - drop;
+        positions[count*3+2] = (float) j * sideLength;
+        
+        vec3 norm = m_normals[i][j];
+        normals[count*3] = norm.x;
+        normals[count*3+1] = norm.y;
+        normals[count*3+2] = norm.z;
+        
+        textureCoords[count*2] = (float) j / (float) quads * shrinkFactor;
+        textureCoords[count*2+1] = (float) i / (float) quads * shrinkFactor;
+        
+        count++;
+    };
+    
+    for (int ci=0; ci<chunksPerSide; ci++) {
+        for (int cj=0; cj<chunksPerSide; cj++) {
+            Chunk& chunk = m_chunks[ci * chunksPerSide + cj];
+            chunk.baseVertex = count;
             
-            // "Shrink" the displayed texture so that it repeats instead of being 1 large texture
-            // and so that it always looks about the same, regardless of how large we make the terrain
-            float shrinkFactor = m_size / 50.0f;
+            int i0 = ci * CHUNK_QUADS;
+            int j0 = cj * CHUNK_QUADS;
+            for (int a=0; a<=CHUNK_QUADS; a++)
+                for (int b=0; b<=CHUNK_QUADS; b++)
+                    addVertex(i0 + a, j0 + b, 0.0f);
             
-            GLfloat xT = (float) j /  ((float) m_heightMapSize - 1);
-            GLfloat yT = (float) i / ((float) m_heightMapSize - 1);
-            textureCoords[count*2] = xT * shrinkFactor;
-            textureCoords[count*2+1] = yT * shrinkFactor;
+            // Skirts along the outside of the terrain would be visible from afar, so they get a depth of 0
+            float drop[4] = {
+                (ci == 0) ? 0.0f : skirtDepth,                              // i = 0
+                (i0 + CHUNK_QUADS >= quads) ? 0.0f : skirtDepth,            // i = CHUNK_QUADS
+                (cj == 0) ? 0.0f : skirtDepth,                              // j = 0
+                (j0 + CHUNK_QUADS >= quads) ? 0.0f : skirtDepth,            // j = CHUNK_QUADS
+            };
+            for (int k=0; k<=CHUNK_QUADS; k++) addVertex(i0, j0 + k, drop[0]);
+            for (int k=0; k<=CHUNK_QUADS; k++) addVertex(i0 + CHUNK_QUADS, j0 + k, drop[1]);
+            for (int k=0; k<=CHUNK_QUADS; k++) addVertex(i0 + k, j0, drop[2]);
+            for (int k=0; k<=CHUNK_QUADS; k++) addVertex(i0 + k, j0 + CHUNK_QUADS, drop[3]);
             
-            count++;
+            // Bounding box of the chunk (including its skirt)
+            chunk.minBounds = chunk.maxBounds = vec3(positions[chunk.baseVertex*3],
+                                                     positions[chunk.baseVertex*3+1],
+                                                     positions[chunk.baseVertex*3+2]);
+            for (int v=chunk.baseVertex; v<count; v++) {
+                vec3 p(positions[v*3], positions[v*3+1], positions[v*3+2]);
+                chunk.minBounds = glm::min(chunk.minBounds, p);
+                chunk.maxBounds = glm::max(chunk.maxBounds, p);
+            }
         }
     }
-    m_vbo = storeToVBO(positions, sizeof(GLfloat) * totalVtcs * 3,
-                       normals, sizeof(GLfloat) * totalVtcs * 3,
-                       textureCoords, sizeof(GLfloat) * totalVtcs * 2);
-
-    // Generate the indices for drawing these triangles
-    m_numIndices = 6 * (m_heightMapSize-1) * (m_heightMapSize -1);
-    GLuint* indices = new GLuint[m_numIndices];
-    count = 0;
-    for (int i=0; i<m_heightMapSize-1; i++) {
-        for (int j=0; j<m_heightMapSize-1; j++) {
-            // Make a square out of 2 triangles
-            GLuint topLeft = i * m_heightMapSize + j;  // adding m_heightMapSize skips to "next row"
-            GLuint topRight = topLeft + 1;          // adding 1 skips to "next column"
-            GLuint bottomLeft = (i+1) * m_heightMapSize + j;
-            GLuint bottomRight = bottomLeft + 1;
-            
-            indices[count++] = topLeft;
-            indices[count++] = bottomLeft;
-            indices[count++] = topRight;
+    
+    // 3) Generate the indices of each level of detail (relative to the chunk's first vertex)
+    vector<GLuint> levelIndices[NUM_LODS];
+    for (int level=0; level<NUM_LODS; level++) {
+        int step = 1 << level;  // level n only uses every 2^n-th vertex
+        vector<GLuint>& indices = levelIndices[level];
+        
+        for (int a=0; a<CHUNK_QUADS; a+=step) {
+            for (int b=0; b<CHUNK_QUADS; b+=step) {
+                // Make a square out of 2 triangles
+                GLuint topLeft = a * CHUNK_VERTICES + b;        // adding CHUNK_VERTICES skips to "next row"
+                GLuint topRight = topLeft + step;               // adding 1 skips to "next column"
+                GLuint bottomLeft = (a+step) * CHUNK_VERTICES + b;
+                GLuint bottomRight = bottomLeft + step;
+                
+                indices.insert(indices.end(), { topLeft, bottomLeft, topRight });
+                indices.insert(indices.end(), { topRight, bottomLeft, bottomRight });
+            }
+        }
+        
+        // Skirts: connect each pair of edge vertices used by this level to the ones hanging below them
+        for (int k=0; k<CHUNK_QUADS; k+=step) {
+            GLuint top[4] = {
+                (GLuint) (k),                                               // i = 0
+                (GLuint) (CHUNK_QUADS * CHUNK_VERTICES + k),                // i = CHUNK_QUADS
+                (GLuint) (k * CHUNK_VERTICES),                              // j = 0
+                (GLuint) (k * CHUNK_VERTICES + CHUNK_QUADS),                // j = CHUNK_QUADS
+            };
+            GLuint next = (GLuint) step;
+            GLuint nextRow = (GLuint) (step * CHUNK_VERTICES);
+            GLuint topStep[4] = { next, next, nextRow, nextRow };
             
-            indices[count++] = topRight;
-            indices[count++] = bottomLeft;
-            indices[count++] = bottomRight;
+            for (int edge=0; edge<4; edge++) {
+                GLuint bottom = CHUNK_VERTICES * CHUNK_VERTICES + edge * CHUNK_VERTICES + k;
+                GLuint t0 = top[edge], t1 = top[edge] + topStep[edge];
+                GLuint b0 = bottom, b1 = bottom + step;
+                
+                indices.insert(indices.end(), { t0, b0, t1 });
+                indices.insert(indices.end(), { t1, b0, b1 });
+            }
         }
     }
-    m_ebo = storeToEBO(indices, sizeof(GLuint) * m_numIndices);
+    
+    // 4) Reorder them for the GPU's caches (see MeshOptimizer.hpp). Each level gets its own triangle
+    //    order, but all of them share the vertices: these are put in the order the full detail level
+    //    first uses them, which the coarser levels (using a subset of them) also mostly follow
+    for (int level=0; level<NUM_LODS; level++) {
+#ifdef DEBUG_PRINT
+        VertexCacheStats before = analyzeVertexCache(levelIndices[level], VERTICES_PER_CHUNK);
+#endif
+        optimizeVertexCache(levelIndices[level], VERTICES_PER_CHUNK);
+#ifdef DEBUG_PRINT
+        VertexCacheStats after = analyzeVertexCache(levelIndices[level], VERTICES_PER_CHUNK);
+        cout << "Optimized terrain level " << level << " (" << levelIndices[level].size() / 3 << " triangles): "
+             << "ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+#endif
+    }
+    vector<GLuint> remap = optimizeVertexFetch(levelIndices[0], VERTICES_PER_CHUNK);
+    for (int level=1; level<NUM_LODS; level++)
+        for (GLuint& index : levelIndices[level]) index = remap[index];
+    
+    // All of the levels go one after the other in the same buffer
+    // Note: chunks only have VERTICES_PER_CHUNK vertices, so 16 bit indices are enough
+    vector<GLushort>& indices = m_staging.indices;
+    indices.clear();
+    for (int level=0; level<NUM_LODS; level++) {
+        m_levels[level].offset = indices.size() * sizeof(GLushort);
+        m_levels[level].count = (GLsizei) levelIndices[level].size();
+        indices.insert(indices.end(), levelIndices[level].begin(), levelIndices[level].end());
+    }
+    
+    // The GPU gets a compact copy of the vertices (12 bytes each instead of 32 - see VertexFormat.hpp)
+    vec3 minBounds = m_chunks[0].minBounds, maxBounds = m_chunks[0].maxBounds;
+    for (Chunk& chunk : m_chunks) {
+        minBounds = glm::min(minBounds, chunk.minBounds);
+        maxBounds = glm::max(maxBounds, chunk.maxBounds);
+    }
+    m_quantization = Quantization(minBounds, maxBounds, 0.0f, shrinkFactor);
+    
+#ifdef TERRAIN_PLANAR_VERTICES
+    vector<GLshort>& packedPositions = m_staging.positions;
+    vector<GLshort>& packedNormals = m_staging.normals;
+    vector<GLushort>& packedTextureCoords = m_staging.textureCoords;
+    packedPositions.resize(totalVtcs * 4);
+    packedNormals.resize(totalVtcs * 2);
+    packedTextureCoords.resize(totalVtcs * 2);
+    for (int v=0; v<totalVtcs; v++) {
+        // Every chunk's vertices get shuffled the same way (see 4)
+        int p = (v / VERTICES_PER_CHUNK) * VERTICES_PER_CHUNK + remap[v % VERTICES_PER_CHUNK];
+        m_quantization.packPosition(vec3(positions[v*3], positions[v*3+1], positions[v*3+2]), &packedPositions[p*4]);
+        Quantization::packNormal(vec3(normals[v*3], normals[v*3+1], normals[v*3+2]), &packedNormals[p*2]);
+        m_quantization.packTexCoords(vec2(textureCoords[v*2], textureCoords[v*2+1]), &packedTextureCoords[p*2]);
+    }
+#else
+    // Each vertex is read with a single fetch (the texture coordinates come from the position)
+    vector<TerrainVertex>& packed = m_staging.vertices;
+    packed.resize(totalVtcs);
+    for (int v=0; v<totalVtcs; v++) {
+        // Every chunk's vertices get shuffled the same way (see 4)
+        int p = (v / VERTICES_PER_CHUNK) * VERTICES_PER_CHUNK + remap[v % VERTICES_PER_CHUNK];
+        m_quantization.packPosition(vec3(positions[v*3], positions[v*3+1], positions[v*3+2]), packed[p].position);
+        Quantization::packNormal(vec3(normals[v*3], normals[v*3+1], normals[v*3+2]), packed[p].normal);
+    }
+#endif
+}
+
+void Terrain::upload()
+{
+    if (m_chunks.empty()) return;   // the height map couldn't be loaded
+    
+    glBindVertexArray(m_vao);
+    m_shader->enable();
+    
+    m_ebo = storeToEBO(m_staging.indices.data(), sizeof(GLushort) * (int) m_staging.indices.size());
+    
+#ifdef TERRAIN_PLANAR_VERTICES
+    int sizeP = sizeof(GLshort) * (int) m_staging.positions.size();
+    int sizeN = sizeof(GLshort) * (int) m_staging.normals.size();
+    int sizeT = sizeof(GLushort) * (int) m_staging.textureCoords.size();
+    m_vbo = storeToVBO(m_staging.positions.data(), sizeP, m_staging.normals.data(), sizeN, m_staging.textureCoords.data(), sizeT);
+#else
+    m_vbo = storeToVBO(m_staging.vertices.data(), (int) (sizeof(TerrainVertex) * m_staging.vertices.size()));
+#endif
+    m_staging = Staging();  // the GPU has its own copy now
     
     // Load the grass image into texture unit 0
     glActiveTexture(GL_TEXTURE0);
@@ -98,42 +281,44 @@ Terrain::Terrain(ShaderProgram* shader, Scene* scene, float size, float max) : O
     glActiveTexture(GL_TEXTURE1);
     m_textureIDs.push_back( storeTex("Assets/Terrain/dirt.png", GL_REPEAT) );
     
-    // Tell OpenGL where to find/how to interpret...
+#ifdef TERRAIN_PLANAR_VERTICES
+    // Tell OpenGL where to find/how to interpret... (same formats as PackedVertex, just not interleaved)
     //      1) The vertex positions
     GLint location = m_shader->getAttribLocation("position");
-    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    glVertexAttribPointer(location, 3, GL_SHORT, GL_FALSE, sizeof(GLshort) * 4, 0);
     glEnableVertexAttribArray(location);
     
     //      2) The vertex normals
     location = m_shader->getAttribLocation("normal");
-    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(GLfloat) * totalVtcs * 3));
+    glVertexAttribPointer(location, 2, GL_SHORT, GL_FALSE, 0, (void*)(intptr_t) sizeP);
     glEnableVertexAttribArray(location);
     
     //      3)  The texture coordinates
     location = m_shader->getAttribLocation("textureCoords");
-    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(GLfloat) * totalVtcs * 6));
+    glVertexAttribPointer(location, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0, (void*)(intptr_t) (sizeP + sizeN));
     glEnableVertexAttribArray(location);
+#else
+    // Tell OpenGL where to find/how to interpret...
+    //      1-3) The vertices (see VertexFormat.hpp)
+    TerrainVertex::setAttributes();
+#endif
     
     //      4) The grass texture uniform
     glActiveTexture(GL_TEXTURE0);
-    location = m_shader->getUniformLocation("GrassTexture");
-    glUniform1i(location, 0);   // texture unit 0
+    m_shader->set(Uniform::GrassTexture, 0);   // texture unit 0
     
     //      5) The dirt texture uniform
     glActiveTexture(GL_TEXTURE1);
-    location = m_shader->getUniformLocation("DirtTexture");
-    glUniform1i(location, 1);   // texture unit 1
+    m_shader->set(Uniform::DirtTexture, 1);    // texture unit 1
     
     //     6) The shadow map texture uniform
     glActiveTexture(GL_TEXTURE2);
-    location = m_shader->getUniformLocation("ShadowMap");
-    glUniform1i(location, 2);   // texture unit 2
+    m_shader->set(Uniform::ShadowMap, 2);      // texture unit 2
 
-    uploadMaterialUniforms(vec3(1.0, 1.0, 1.0), // kd
-                           vec3(0.1, 0.1, 0.1), // ks - very little specular lighting for terrain
-                           32);                 // shininess
+    setMaterial(vec3(1.0, 1.0, 1.0), // kd
+                vec3(0.1, 0.1, 0.1), // ks - very little specular lighting for terrain
+                32);                 // shininess
     
-    free(heightMap);
     m_shader->disable();
     glBindVertexArray(0);
     releaseData();
@@ -172,6 +357,45 @@ void Terrain::calculateHeightsAndNormals(unsigned char* heightMap)
     }
 }
 
+// Height of the height map at grid coordinate i, j (clamped to the edges of the map)
+float Terrain::heightAt(int i, int j)
+{
+    i = std::min(i, (int) m_heightMapSize - 1);
+    j = std::min(j, (int) m_heightMapSize - 1);
+    return m_heights[i][j];
+}
+
+// Largest vertical distance between the height map & the surface formed by the triangles of the
+// chunk which starts at grid coordinate i0, j0 when only every step-th vertex is used
+float Terrain::chunkError(int i0, int j0, int step)
+{
+    float error = 0.0f;
+    for (int a=0; a<=CHUNK_QUADS; a++) {
+        for (int b=0; b<=CHUNK_QUADS; b++) {
+            // Find the coarse square this vertex lies in & our position within it (range 0-1)
+            int a0 = std::min(a / step * step, CHUNK_QUADS - step);
+            int b0 = std::min(b / step * step, CHUNK_QUADS - step);
+            float fa = (float) (a - a0) / step;
+            float fb = (float) (b - b0) / step;
+            
+            float topLeft = heightAt(i0 + a0, j0 + b0);
+            float topRight = heightAt(i0 + a0, j0 + b0 + step);
+            float bottomLeft = heightAt(i0 + a0 + step, j0 + b0);
+            float bottomRight = heightAt(i0 + a0 + step, j0 + b0 + step);
+            
+            // Same triangles as in the index buffer: the diagonal goes from top right to bottom left
+            float coarse;
+            if (fa + fb <= 1.0f)
+                coarse = topLeft + fa * (bottomLeft - topLeft) + fb * (topRight - topLeft);
+            else
+                coarse = bottomRight + (1.0f - fa) * (topRight - bottomRight) + (1.0f - fb) * (bottomLeft - bottomRight);
+            
+            error = std::max(error, std::abs(heightAt(i0 + a, j0 + b) - coarse));
+        }
+    }
+    return error;
+}
+
 // Use barycentric coordinates to determine the height at point pos given 3 vertices p1/p2/p3
 float Terrain::baryCentric(vec3 p1, vec3 p2, vec3 p3, vec2 pos)
 {
@@ -225,62 +449,71 @@ float Terrain::getHeightAt(float worldX, float worldZ)
 
 // Rendering ----------------------------------------------------------------------------------------
 
-void Terrain::uploadCustomUniforms(Mode m)
+ObjectUniforms Terrain::objectUniforms(Mode m)
 {
-    GLint location = m_shader->getUniformLocation("IsTerrainObject");
-    glUniform1i(location, true);
+    // Note: the matrix which transforms to shadow map space is published once per frame by the FrameContext
+    ObjectUniforms data = Object::objectUniforms(m);
+    data.flags.x = true; // is terrain object
+    data.dequantScale = m_quantization.scale();
+    data.dequantOffset = m_quantization.offset();
     
-    location = m_shader->getUniformLocation("IsMeshObject");
-    glUniform1i(location, false);
-    
-    mat4 view = m_scene->sun()->viewMatrix();
-    mat4 proj = m_scene->sun()->orthographicProjMatrix();
-    mat4 toShadowMapSpace = proj * view;
-
-    location = m_shader->getUniformLocation("ToShadowMapSpace");
-    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(toShadowMapSpace));
-    
-    CHECK_GL_ERRORS;
+#ifndef TERRAIN_PLANAR_VERTICES
+    // The texture repeats every TEXTURE_REPEAT_DISTANCE units: the shader gets the coordinates as
+    // position.zx * scale.w + offset.w (see the constructor)
+    data.flags.w = true; // derive the texture coordinates from the position
+    data.dequantScale.w = 1.0f / TEXTURE_REPEAT_DISTANCE;
+    data.dequantOffset.w = 0.0f;
+#endif
+    return data;
 }
 
-void Terrain::bindData()
+void Terrain::describeDraw(DrawPacket& packet)
 {
-    glBindBuffer( GL_ARRAY_BUFFER, m_vbo );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_ebo );
-    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_textureIDs[0]);
-    
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_textureIDs[1]);
+    packet.addTexture(GL_TEXTURE_2D, m_textureIDs[0]);              // texture unit 0
+    packet.addTexture(GL_TEXTURE_2D, m_textureIDs[1]);              // texture unit 1
+    packet.addTexture(GL_TEXTURE_2D_ARRAY, m_scene->shadowMapTexture());    // texture unit 2
     
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_scene->shadowMapTexture());
-    
-    CHECK_GL_ERRORS;
+    packet.primitive = GL_TRIANGLES;
+    packet.indexType = GL_UNSIGNED_SHORT;
 }
 
-void Terrain::drawElements()
+// Submits 1 copy of the packet per visible chunk, each with its own level of detail
+void Terrain::submitDraws(RenderQueue& queue, DrawPacket& packet)
 {
-    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, nullptr);
+    FrameContext* frame = m_scene->frame();
+    vec3 eye = vec3(frame->pass().cameraPosition);
+    mat4 model = modelMatrix();
     
-    CHECK_GL_ERRORS;
-}
-
-void Terrain::releaseData()
-{
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+    // Only the main pass' numbers get displayed
+    bool countStats = (frame->mode() == REGULAR);
+    if (countStats) {
+        m_chunksDrawn = 0;
+        m_trianglesDrawn = 0;
+    }
     
-    CHECK_GL_ERRORS;
+    for (Chunk& chunk : m_chunks) {
+        AABB box = AABB::transform(model, chunk.minBounds, chunk.maxBounds);
+        if (!queue.isVisible(box)) continue;
+        
+        /*
+         A geometric error of e world units, seen from a distance d, covers roughly e * lodScale / d
+         pixels on the screen. We pick the coarsest level whose error stays under the tolerance when
+         seen from the closest point of the chunk.
+         */
+        float dist = std::max(length(eye - glm::clamp(eye, box.min, box.max)), 1.0f);
+        int level = 0;
+        while (level + 1 < NUM_LODS && chunk.error[level+1] * frame->lodScale() <= m_lodTolerance * dist)
+            level++;
+        
+        packet.first = m_levels[level].offset;
+        packet.count = m_levels[level].count;
+        packet.baseVertex = chunk.baseVertex;
+        queue.submit(packet);
+        
+        if (countStats) {
+            m_chunksDrawn++;
+            m_trianglesDrawn += packet.count / 3;
+        }
+    }
 }
 
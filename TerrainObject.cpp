@@ -5,7 +5,7 @@
 using namespace std;
 using namespace glm;
 
-TerrainObject::TerrainObject(ShaderProgram* shader, Scene* scene, string path) : Model(shader, scene, path)
+TerrainObject::TerrainObject(Shader* shader, Scene* scene, string path) : Model(shader, scene, path)
 {
 }
 
@@ -0,0 +1,240 @@
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+#include "GLState.hpp"
+#include "cs488-framework/GlErrorCheck.hpp"
+#include "lodepng/lodepng.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+static const unsigned char PLACEHOLDER_COLOR[4] = { 128, 128, 128, 255 };  // also a flat normal/no distortion for the water's maps
+
+TextureLoader& TextureLoader::get()
+{
+    static TextureLoader loader;
+    return loader;
+}
+
+TextureLoader::TextureLoader() : m_pending(0), m_nextPbo(0)
+{
+    // The workers use the loader, so the pool has to outlive it (statics are destroyed in reverse order)
+    ThreadPool::get();
+
+    glGenBuffers(PBO_COUNT, m_pbos);
+}
+
+TextureLoader::~TextureLoader()
+{
+    // Wait for the workers to be done with our requests
+    // Note: the GL context is long gone by now, so only the CPU side gets cleaned up
+    unique_lock<mutex> lock(m_mutex);
+    m_decodedChanged.wait(lock, [this] { return (int) m_decoded.size() == m_pending; });
+    for (auto& request : m_decoded)
+        for (Image& img : request->images) img.pixels.release();
+}
+
+// Requests ------------------------------------------------------------------------------------
+
+GLuint TextureLoader::load2D(const string& path, GLenum wrapping)
+{
+    // Check if this particular texture has already been loaded & return its ID if so
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto it = m_cache.find(path);
+        if (it != m_cache.end()) return it->second;
+    }
+
+    shared_ptr<Request> request = make_shared<Request>();
+    request->texture = placeholder(GL_TEXTURE_2D, wrapping);
+    request->target = GL_TEXTURE_2D;
+    request->paths.push_back(path);
+    request->images.resize(1);
+    request->remaining = 1;
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_cache[path] = request->texture;
+        m_pending++;
+    }
+    ThreadPool::get().submit([this, request] { decode(request, 0); });
+
+    return request->texture;
+}
+
+GLuint TextureLoader::loadCubeMap(const vector<string>& faces)
+{
+    string key;
+    for (const string& face : faces) key += face + "|";
+    {
+        lock_guard<mutex> lock(m_mutex);
+        auto it = m_cache.find(key);
+        if (it != m_cache.end()) return it->second;
+    }
+
+    shared_ptr<Request> request = make_shared<Request>();
+    request->texture = placeholder(GL_TEXTURE_CUBE_MAP, GL_CLAMP_TO_EDGE);
+    request->target = GL_TEXTURE_CUBE_MAP;
+    request->paths = faces;
+    request->images.resize(faces.size());
+    request->remaining = (int) faces.size();
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_cache[key] = request->texture;
+        m_pending++;
+    }
+
+    // Every face gets decoded on its own - the cube map is uploaded once all of them are done
+    for (int i=0; i<(int) faces.size(); i++)
+        ThreadPool::get().submit([this, request, i] { decode(request, i); });
+
+    return request->texture;
+}
+
+// Creates a texture holding a single grey texel (on every face, for cube maps)
+GLuint TextureLoader::placeholder(GLenum target, GLenum wrapping)
+{
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(target, tex);
+
+    if (target == GL_TEXTURE_CUBE_MAP) {
+        for (int i=0; i<6; i++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_COLOR);
+
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, wrapping);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_COLOR);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        if (wrapping == GL_CLAMP_TO_BORDER) {
+            // Specify a border color
+            float borderColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };   // clear
+            glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapping);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapping);
+
+    CHECK_GL_ERRORS;
+    return tex;
+}
+
+// Runs on a worker thread
+void TextureLoader::decode(shared_ptr<Request> request, int image)
+{
+    Image& img = request->images[image];
+    img.error = 0;
+    if (!img.pixels.map(request->paths[image]))
+        img.error = img.pixels.cook(request->paths[image]);
+
+    // The last image to finish hands the request over to the main thread
+    if (--request->remaining > 0) return;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_decoded.push_back(request);
+    }
+    m_decodedChanged.notify_all();
+}
+
+// Uploading -----------------------------------------------------------------------------------
+
+void TextureLoader::update(size_t maxBytes)
+{
+    vector< shared_ptr<Request> > ready;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        size_t bytes = 0, count = 0;
+        while (count < m_decoded.size() && (count == 0 || bytes < maxBytes)) {
+            for (Image& img : m_decoded[count]->images) bytes += img.pixels.size;
+            count++;
+        }
+        ready.assign(m_decoded.begin(), m_decoded.begin() + count);
+        m_decoded.erase(m_decoded.begin(), m_decoded.begin() + count);
+    }
+    if (ready.empty()) return;
+
+    for (auto& request : ready) upload(*request);
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_pending -= (int) ready.size();
+    }
+    m_decodedChanged.notify_all();
+}
+
+void TextureLoader::upload(Request& request)
+{
+    bool failed = false;
+    for (size_t i=0; i<request.images.size(); i++) {
+        Image& img = request.images[i];
+        if (img.error) {
+            cerr << "Error decoding " << request.paths[i] << ". " << img.error << ": " << lodepng_error_text(img.error) << endl;
+            failed = true;
+        }
+    }
+
+    // Note: broken textures keep their placeholder
+    GLState::get().bindTexture(0, request.target, request.texture);
+    for (size_t i=0; i<request.images.size(); i++) {
+        CookedTexture& tex = request.images[i].pixels;
+        if (!failed) {
+            /*
+             Copy the pixels into the next buffer of the ring & have OpenGL read them from there: the
+             copy into the texture then happens on the GPU's time, without the driver having to keep
+             its own copy of our array. Each buffer is reallocated before being written to ("orphaning"
+             it), so we never wait on the GPU to finish reading what it held before.
+             */
+            // Note: only 2D textures are mipmapped, the cube maps only need the first level
+            bool cube = (request.target == GL_TEXTURE_CUBE_MAP);
+            int levels = cube ? 1 : tex.levels;
+            size_t size = tex.levelOffset(levels);
+
+            GLuint pbo = m_pbos[m_nextPbo];
+            m_nextPbo = (m_nextPbo + 1) % PBO_COUNT;
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+            void* pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            memcpy(pixels, tex.pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // The mip chain was computed when the texture got cooked, so the levels are uploaded as is
+            GLenum face = cube ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum) i : GL_TEXTURE_2D;
+            for (int level=0; level<levels; level++)
+                glTexImage2D(face, level, GL_RGBA, tex.levelWidth(level), tex.levelHeight(level), 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, (void*)(intptr_t) tex.levelOffset(level));
+            glTexParameteri(request.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        }
+        tex.release();
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    CHECK_GL_ERRORS;
+}
+
+void TextureLoader::finish()
+{
+    while (true) {
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_decodedChanged.wait(lock, [this] { return m_pending == 0 || !m_decoded.empty(); });
+            if (m_pending == 0) return;
+        }
+        update(SIZE_MAX);
+    }
+}
+
+int TextureLoader::pending()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_pending;
+}
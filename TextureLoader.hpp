@@ -0,0 +1,75 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/OpenGLImport.hpp"
+#include "CookedTexture.hpp"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ Loads PNG textures without holding up the main thread:
+    1) load2D/loadCubeMap hand out a texture right away, which holds a 1x1 grey placeholder image
+    2) the thread pool decodes the PNGs in the background (the 6 faces of a cube map in parallel),
+       or rather maps in their cooked versions if they have been loaded before (see CookedTexture)
+    3) once per frame, update() uploads the images which are done decoding into their textures,
+       through a ring of pixel buffer objects
+ The texture's ID never changes, so whatever holds on to it (materials, draw packets) starts
+ drawing the real image as soon as it's been uploaded.
+
+ Textures are cached by path, so each file only gets loaded once.
+ Note: everything but the decoding happens on the main thread (it needs the GL context)
+ */
+class TextureLoader {
+    static const int PBO_COUNT = 3;
+
+    struct Image {
+        CookedTexture pixels;
+        unsigned error;         // lodepng's error code
+    };
+
+    struct Request {
+        GLuint texture;
+        GLenum target;                      // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+        std::vector<std::string> paths;     // 1, or 1 per face of the cube map
+        std::vector<Image> images;
+        std::atomic<int> remaining;         // images which are still being decoded
+    };
+
+    std::mutex m_mutex;     // guards everything below
+    std::unordered_map<std::string, GLuint> m_cache;
+    std::vector< std::shared_ptr<Request> > m_decoded;  // waiting to be uploaded
+    std::condition_variable m_decodedChanged;
+    int m_pending;          // requests which haven't been uploaded yet
+
+    GLuint m_pbos[PBO_COUNT];
+    int m_nextPbo;
+
+    TextureLoader();
+
+    GLuint placeholder(GLenum target, GLenum wrapping);
+    void decode(std::shared_ptr<Request> request, int image);
+    void upload(Request& request);
+
+public:
+    static TextureLoader& get();
+    ~TextureLoader();
+
+    // The texture is left bound to the active texture unit
+    GLuint load2D(const std::string& path, GLenum wrapping = GL_REPEAT);
+    GLuint loadCubeMap(const std::vector<std::string>& faces);
+
+    // Uploads the textures which finished decoding, until about maxBytes were uploaded (at least one
+    // texture always gets uploaded, so big ones don't get stuck)
+    void update(size_t maxBytes = 16 * 1024 * 1024);
+
+    // Blocks until every texture requested so far has been uploaded
+    void finish();
+
+    int pending();
+};
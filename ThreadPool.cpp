@@ -0,0 +1,67 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+using namespace std;
+
+ThreadPool& ThreadPool::get()
+{
+    // Note: hardware_concurrency may return 0 if it can't tell
+    static ThreadPool pool(std::max((int) thread::hardware_concurrency() - 1, 1));
+    return pool;
+}
+
+ThreadPool::ThreadPool(int threads) : m_running(0), m_stopping(false)
+{
+    for (int i=0; i<threads; i++)
+        m_workers.push_back(thread(&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    // Let the workers finish whatever is left in the queue before they exit
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+    for (thread& worker : m_workers) worker.join();
+}
+
+void ThreadPool::submit(function<void()> job)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_jobs.push(std::move(job));
+    }
+    m_jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_jobs.empty() && m_running == 0; });
+}
+
+void ThreadPool::work()
+{
+    while (true) {
+        function<void()> job;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty()) return;     // only when stopping
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+            m_running++;
+        }
+
+        job();
+
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_running--;
+            if (m_jobs.empty() && m_running == 0) m_idle.notify_all();
+        }
+    }
+}
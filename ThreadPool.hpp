@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ A fixed set of worker threads which run jobs in the order they were submitted. Used for the work
+ done while loading which doesn't need the GL context (ie. decoding images) - anything that touches
+ OpenGL has to stay on the main thread.
+ */
+class ThreadPool {
+    std::vector<std::thread> m_workers;
+    std::queue< std::function<void()> > m_jobs;
+
+    std::mutex m_mutex;                         // guards everything below
+    std::condition_variable m_jobAvailable;
+    std::condition_variable m_idle;             // signalled whenever the last running job finishes
+    int m_running;                              // jobs which were picked up but aren't done yet
+    bool m_stopping;
+
+    void work();
+
+    ThreadPool(int threads);
+
+public:
+    static ThreadPool& get();   // one worker per core, minus one for the main thread
+    ~ThreadPool();
+
+    void submit(std::function<void()> job);
+    void wait();                // blocks until every job submitted so far is done
+
+    int threadCount()           { return (int) m_workers.size(); };
+};
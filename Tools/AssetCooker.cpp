@@ -0,0 +1,114 @@
+/*
+ Cooks every model (.obj) & texture (.png) under a directory ahead of time - the game cooks whatever
+ is missing or out of date on its own when it starts, so this is only needed to skip that wait on
+ the first launch. For every asset, it reports how long it takes to load:
+    - cold: from its source file, which includes cooking it
+    - warm: from its cooked file, which is what every launch after the first one does
+
+ Usage (from the folder which holds Assets/, like the game): AssetCooker [directory, default Assets]
+ */
+#include "../CookedModel.hpp"
+#include "../CookedTexture.hpp"
+#include <dirent.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static bool endsWith(const string& s, const string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Every .obj & .png under dir, in alphabetical order
+static void findAssets(const string& dir, vector<string>& assets)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+
+    while (dirent* entry = readdir(d)) {
+        string name = entry->d_name;
+        if (name[0] == '.') continue;
+
+        string path = dir + "/" + name;
+        if (endsWith(name, ".obj") || endsWith(name, ".png"))
+            assets.push_back(path);
+        else if (entry->d_type == DT_DIR)
+            findAssets(path, assets);
+    }
+    closedir(d);
+    sort(assets.begin(), assets.end());
+}
+
+static double millisecondsSince(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    string root = (argc > 1) ? argv[1] : "Assets";
+    vector<string> assets;
+    findAssets(root, assets);
+    if (assets.empty()) {
+        fprintf(stderr, "No models or textures found under %s\n", root.c_str());
+        return 1;
+    }
+
+    double totalCold = 0.0, totalWarm = 0.0;
+    int failures = 0;
+    vector<string> report;
+    for (const string& path : assets) {
+        double cold, warm;
+        bool ok;
+
+        if (endsWith(path, ".obj")) {
+            auto start = chrono::steady_clock::now();
+            ok = CookedModel().cook(path);
+            cold = millisecondsSince(start);
+
+            start = chrono::steady_clock::now();
+            ok = ok && CookedModel().load(path);
+            warm = millisecondsSince(start);
+        } else {
+            CookedTexture texture;
+            auto start = chrono::steady_clock::now();
+            ok = (texture.cook(path) == 0);
+            cold = millisecondsSince(start);
+            texture.release();
+
+            // Loading a texture means copying all of its bytes into a pixel buffer, which is also
+            // when the mapped file actually gets read in
+            start = chrono::steady_clock::now();
+            ok = ok && texture.map(path);
+            if (ok) {
+                vector<unsigned char> copy(texture.size);
+                memcpy(copy.data(), texture.pixels, texture.size);
+            }
+            warm = millisecondsSince(start);
+            texture.release();
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Error cooking %s\n", path.c_str());
+            failures++;
+            continue;
+        }
+        totalCold += cold;
+        totalWarm += warm;
+
+        char line[512];
+        snprintf(line, sizeof(line), "%10.2f %10.2f  %s", cold, warm, path.c_str());
+        report.push_back(line);
+    }
+
+    printf("\n%10s %10s  (milliseconds)\n", "cold", "warm");
+    for (const string& line : report) printf("%s\n", line.c_str());
+    printf("%10.2f %10.2f  total (%d assets, %d failed)\n", totalCold, totalWarm, (int) report.size(), failures);
+
+    return failures ? 1 : 0;
+}
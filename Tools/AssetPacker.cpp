@@ -0,0 +1,174 @@
+/*
+ Packs every file under a directory into the asset archive which the game mounts at startup (see
+ FileSystem.hpp for its layout). The shaders go first since they're the first thing the game loads,
+ followed by everything else in alphabetical order - so reading the archive from start to end is
+ about the order the game needs its files in.
+
+ Source art which the game never loads (.blend files) is left out.
+
+ Usage (from the folder which holds Assets/, like the game): AssetPacker [directory, default Assets]
+                                                                         [archive, default Assets.pack]
+ */
+#include "../FileSystem.hpp"
+#include "lodepng/lodepng.h"
+#include <dirent.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A file is only compressed if that saves at least this much of it
+static const double MIN_COMPRESSION_SAVINGS = 0.1;
+
+static bool endsWith(const string& s, const string& suffix)
+{
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void findFiles(const string& dir, vector<string>& files)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+
+    while (dirent* entry = readdir(d)) {
+        string name = entry->d_name;
+        if (name[0] == '.' || endsWith(name, ".blend")) continue;
+
+        string path = dir + "/" + name;
+        if (entry->d_type == DT_DIR)
+            findFiles(path, files);
+        else if (entry->d_type == DT_REG)
+            files.push_back(path);
+    }
+    closedir(d);
+}
+
+int main(int argc, char** argv)
+{
+    string root = FileSystem::normalize((argc > 1) ? argv[1] : "Assets");
+    string archive = (argc > 2) ? argv[2] : "Assets.pack";
+    auto start = chrono::steady_clock::now();
+
+    vector<string> files;
+    findFiles(root, files);
+    if (files.empty()) {
+        fprintf(stderr, "No files found under %s\n", root.c_str());
+        return 1;
+    }
+
+    // The order the files' bytes get laid out in
+    string shaders = root + "/Shaders/";
+    sort(files.begin(), files.end(), [&](const string& a, const string& b) {
+        bool aShader = (a.compare(0, shaders.size(), shaders) == 0);
+        bool bShader = (b.compare(0, shaders.size(), shaders) == 0);
+        return (aShader != bShader) ? aShader : a < b;
+    });
+
+    // 1) Read & compress every file
+    struct PackedFile {
+        PackEntry entry;
+        string path;
+        MappedFile source;
+        unsigned char* compressed;
+    };
+    vector<PackedFile> packed(files.size());
+    uint64_t totalSize = 0, totalStored = 0;
+    for (size_t i=0; i<files.size(); i++) {
+        PackedFile& file = packed[i];
+        file.path = files[i];
+        file.compressed = nullptr;
+        memset(&file.entry, 0, sizeof(PackEntry));
+
+        if (!stampSource(file.path, file.entry.source) || (file.entry.source.size > 0 && !file.source.open(file.path))) {
+            fprintf(stderr, "Error reading %s\n", file.path.c_str());
+            return 1;
+        }
+        file.entry.size = file.source.size;
+        file.entry.storedSize = file.source.size;
+        file.entry.compression = PACK_STORED;
+
+        size_t compressedSize = 0;
+        if (file.source.size > 0 &&
+            lodepng_zlib_compress(&file.compressed, &compressedSize, file.source.data, file.source.size,
+                                  &lodepng_default_compress_settings) == 0 &&
+            compressedSize <= file.source.size * (1.0 - MIN_COMPRESSION_SAVINGS)) {
+            file.entry.storedSize = compressedSize;
+            file.entry.compression = PACK_ZLIB;
+        } else {
+            free(file.compressed);
+            file.compressed = nullptr;
+        }
+
+        totalSize += file.entry.size;
+        totalStored += file.entry.storedSize;
+    }
+
+    // 2) Lay them out: header, entries (sorted by path), paths, then the files' bytes
+    vector<PackedFile*> byPath;
+    for (PackedFile& file : packed) byPath.push_back(&file);
+    sort(byPath.begin(), byPath.end(), [](const PackedFile* a, const PackedFile* b) { return a->path < b->path; });
+
+    string paths;
+    for (PackedFile* file : byPath) {
+        file->entry.pathOffset = (uint32_t) paths.size();
+        file->entry.pathLength = (uint32_t) file->path.size();
+        paths += file->path;
+    }
+
+    uint64_t offset = sizeof(PackHeader) + byPath.size() * sizeof(PackEntry) + paths.size();
+    for (PackedFile& file : packed) {
+        offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+        file.entry.offset = offset;
+        offset += file.entry.storedSize;
+    }
+
+    PackHeader header;
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.entryCount = (uint32_t) packed.size();
+    header.pathsSize = (uint32_t) paths.size();
+
+    // 3) Write it all out
+    string temporary = archive + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out) {
+        fprintf(stderr, "Error writing %s\n", temporary.c_str());
+        return 1;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (PackedFile* file : byPath) written = written && fwrite(&file->entry, sizeof(PackEntry), 1, out) == 1;
+    written = written && (paths.empty() || fwrite(paths.data(), paths.size(), 1, out) == 1);
+
+    static const char zeros[PACK_ALIGNMENT] = {};
+    for (PackedFile& file : packed) {
+        long position = ftell(out);
+        written = written && position >= 0 && (uint64_t) position <= file.entry.offset;
+        size_t padding = written ? file.entry.offset - position : 0;
+        if (padding > 0) written = fwrite(zeros, padding, 1, out) == 1;
+
+        const unsigned char* bytes = file.compressed ? file.compressed : file.source.data;
+        if (file.entry.storedSize > 0)
+            written = written && fwrite(bytes, file.entry.storedSize, 1, out) == 1;
+
+        file.source.close();
+        free(file.compressed);
+    }
+    written = (fclose(out) == 0) && written;
+
+    if (!written || rename(temporary.c_str(), archive.c_str()) != 0) {
+        fprintf(stderr, "Error writing %s\n", archive.c_str());
+        remove(temporary.c_str());
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("Packed %d files (%.2f MB) into %s: %.2f MB once compressed, %.2f MB with the alignment, in %.2f s\n",
+           (int) packed.size(), totalSize / 1e6, archive.c_str(), totalStored / 1e6, offset / 1e6, seconds);
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "VertexFormat.hpp"
+#include "cs488-framework/GlErrorCheck.hpp"
+
+using namespace std;
+using namespace glm;
+
+static const float SHORT_MAX = 32767.0f;     // positions & normals use [-32767, 32767]
+static const float USHORT_MAX = 65535.0f;    // texture coordinates use [0, 65535]
+
+// Attributes ---------------------------------------------------------------------------------
+
+void PackedVertex::setAttributes()
+{
+    // Tell OpenGL where to find/how to interpret...
+    //      1) The vertex positions (not normalized - see above)
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+
+    //      2) The vertex normals (same)
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(1);
+
+    //      3) The texture coordinates (normalized to [0, 1], which is exact for unsigned integers)
+    glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+    glEnableVertexAttribArray(2);
+}
+
+void PackedVertex::setPositionAttribute()
+{
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(GLshort) * 4, (void*)0);
+    glEnableVertexAttribArray(0);
+}
+
+void TerrainVertex::setAttributes()
+{
+    // Same as the first 2 attributes of PackedVertex - the shaders don't read the 3rd one for the terrain
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, normal));
+    glEnableVertexAttribArray(1);
+}
+
+// Quantization -------------------------------------------------------------------------------
+
+Quantization::Quantization() : m_center(0.0f), m_halfExtent(1.0f), m_minTexCoord(0.0f), m_texCoordRange(1.0f)
+{}
+
+Quantization::Quantization(vec3 minBounds, vec3 maxBounds, float minTexCoord, float maxTexCoord) :
+    m_center((minBounds + maxBounds) / 2.0f),
+    m_halfExtent((maxBounds - minBounds) / 2.0f),
+    m_minTexCoord(minTexCoord),
+    m_texCoordRange(maxTexCoord - minTexCoord)
+{
+    // Flat meshes (ie. a quad) have no extent along one of the axes - any scale works there
+    for (int i=0; i<3; i++)
+        if (m_halfExtent[i] <= 0.0f) m_halfExtent[i] = 1.0f;
+    if (m_texCoordRange <= 0.0f) m_texCoordRange = 1.0f;
+}
+
+Quantization Quantization::fit(const vector<MeshVertex>& vertices)
+{
+    if (vertices.empty()) return Quantization();
+
+    vec3 minBounds = vertices[0].position, maxBounds = vertices[0].position;
+    float minTexCoord = vertices[0].texCoords.x, maxTexCoord = vertices[0].texCoords.x;
+    for (const MeshVertex& v : vertices) {
+        minBounds = glm::min(minBounds, v.position);
+        maxBounds = glm::max(maxBounds, v.position);
+
+        // Both texture coordinates share one range, so that they fit in a single vec4 with the positions
+        minTexCoord = std::min(minTexCoord, std::min(v.texCoords.x, v.texCoords.y));
+        maxTexCoord = std::max(maxTexCoord, std::max(v.texCoords.x, v.texCoords.y));
+    }
+    return Quantization(minBounds, maxBounds, minTexCoord, maxTexCoord);
+}
+
+void Quantization::packPosition(vec3 position, GLshort out[4]) const
+{
+    vec3 q = round(clamp((position - m_center) / m_halfExtent, -1.0f, 1.0f) * SHORT_MAX);
+    out[0] = (GLshort) q.x;
+    out[1] = (GLshort) q.y;
+    out[2] = (GLshort) q.z;
+    out[3] = 0;
+}
+
+void Quantization::packTexCoords(vec2 texCoords, GLushort out[2]) const
+{
+    vec2 q = round(clamp((texCoords - m_minTexCoord) / m_texCoordRange, 0.0f, 1.0f) * USHORT_MAX);
+    out[0] = (GLushort) q.x;
+    out[1] = (GLushort) q.y;
+}
+
+void Quantization::packNormal(vec3 normal, GLshort out[2])
+{
+    /*
+     Project the normal onto the octahedron |x| + |y| + |z| = 1: its top half (z >= 0) maps onto the
+     diamond |x| + |y| <= 1 as is, & the bottom half gets folded over into the corners of the square
+     around that diamond. See "A Survey of Efficient Representations for Independent Unit Vectors"
+     (Cigolle et al., 2014) - the shaders have the matching decoder.
+     */
+    float sum = abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec3 n = (sum > 0.0f) ? normal / sum : vec3(0.0f, 0.0f, 1.0f);
+    vec2 e = vec2(n.x, n.y);
+    if (n.z < 0.0f) {
+        vec2 signs = vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+        e = (1.0f - abs(vec2(e.y, e.x))) * signs;
+    }
+
+    vec2 q = round(clamp(e, -1.0f, 1.0f) * SHORT_MAX);
+    out[0] = (GLshort) q.x;
+    out[1] = (GLshort) q.y;
+}
+
+PackedVertex Quantization::pack(const MeshVertex& v) const
+{
+    PackedVertex p;
+    packPosition(v.position, p.position);
+    packNormal(v.normal, p.normal);
+    packTexCoords(v.texCoords, p.texCoords);
+    return p;
+}
+
+vec4 Quantization::scale() const
+{
+    return vec4(m_halfExtent / SHORT_MAX, m_texCoordRange);
+}
+
+vec4 Quantization::offset() const
+{
+    return vec4(m_center, m_minTexCoord);
+}
+
+// Indices ------------------------------------------------------------------------------------
+
+GLuint storeIndices(const vector<GLuint>& indices, size_t numVertices, GLenum& type)
+{
+    GLuint ebo;
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+    if (numVertices <= 65536) {
+        // Half the size, & every index is still in range
+        vector<GLushort> shortIndices(indices.begin(), indices.end());
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+        type = GL_UNSIGNED_SHORT;
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        type = GL_UNSIGNED_INT;
+    }
+
+    CHECK_GL_ERRORS;
+    return ebo;
+}
+
+size_t indexSize(GLenum type)
+{
+    return (type == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#define GL_SILENCE_DEPRECATION // silences warnings on macOS 10.14 related to deprecated OpenGL functions
+
+#include "cs488-framework/OpenGLImport.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Interleaved vertex layout shared by every mesh, as it is kept on the CPU
+// Note: the attribute locations (0 = position, 1 = normal, 2 = texture coordinates) are fixed in the shaders
+struct MeshVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+};
+
+/*
+ Compact version of MeshVertex which is what actually gets uploaded to the GPU (16 bytes instead of 32):
+    - positions are 16 bit integers spanning the bounding box of the mesh
+    - normals are octahedral encoded (the unit sphere gets unfolded onto a square) into 2 16 bit integers
+    - texture coordinates are 16 bit fixed point numbers spanning the range of the mesh's coordinates
+ The Quantization of the mesh maps these back to their original values (see the object vertex shader).
+
+ Note: positions & normals aren't normalized by OpenGL (the conversion for signed normalized integers
+       isn't exact before GL 4.2) - the shaders get the integers as is & do the scaling themselves
+ */
+struct PackedVertex {
+    GLshort position[4];        // w is padding, so that the normal stays 4 byte aligned
+    GLshort normal[2];
+    GLushort texCoords[2];
+
+    // Set up the attributes of the currently bound VAO to read PackedVertex's from the currently
+    // bound array buffer
+    static void setAttributes();
+
+    // Same for a position-only stream (see MeshAsset) - made up of PackedVertex::position's
+    static void setPositionAttribute();
+};
+
+/*
+ Vertex of the terrain's chunks (12 bytes): the same position & normal as PackedVertex, without
+ the texture coordinates - the terrain's texture is just tiled along its x & z axes, so the object
+ vertex shader works its coordinates out from the position instead (see Terrain::objectUniforms)
+ */
+struct TerrainVertex {
+    GLshort position[4];        // w is padding
+    GLshort normal[2];
+    
+    static void setAttributes();
+};
+
+class Quantization {
+    glm::vec3 m_center;
+    glm::vec3 m_halfExtent;
+    float m_minTexCoord;
+    float m_texCoordRange;
+
+public:
+    Quantization();
+    Quantization(glm::vec3 minBounds, glm::vec3 maxBounds, float minTexCoord, float maxTexCoord);
+    static Quantization fit(const std::vector<MeshVertex>& vertices);
+
+    void packPosition(glm::vec3 position, GLshort out[4]) const;
+    void packTexCoords(glm::vec2 texCoords, GLushort out[2]) const;
+    static void packNormal(glm::vec3 normal, GLshort out[2]);
+    PackedVertex pack(const MeshVertex& v) const;
+
+    // Uploaded as part of the per-object uniform block: the shaders compute
+    //      position = packed position * scale.xyz + offset.xyz
+    //      texture coordinates = packed coordinates * scale.w + offset.w
+    glm::vec4 scale() const;
+    glm::vec4 offset() const;
+};
+
+// Uploads indices into a new element buffer (which gets bound to the current VAO), as 16 bit indices
+// whenever there are few enough vertices - type is set to the type of index that got used
+GLuint storeIndices(const std::vector<GLuint>& indices, size_t numVertices, GLenum& type);
+size_t indexSize(GLenum type);
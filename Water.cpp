@@ -5,7 +5,7 @@
 using namespace std;
 using namespace glm;
 
-Water::Water(ShaderProgram* shader, Scene* scene) : Object(shader, scene),
+Water::Water(Shader* shader, Scene* scene) : Object(shader, scene),
     m_renderingMode(REGULAR), m_distortion(0.63f), m_bumpMapping(true)
 {
     // VAO is already bound
@@ -20,7 +20,7 @@ Water::Water(ShaderProgram* shader, Scene* scene) : Object(shader, scene),
     };
     m_vbo = storeToVBO(positions, sizeof(positions));
     
-    GLuint indices[] = {
+    GLushort indices[] = {
         0, 1, 3,
         1, 2, 3
     };
@@ -42,137 +42,67 @@ Water::Water(ShaderProgram* shader, Scene* scene) : Object(shader, scene),
 
     //      2) The reflection texture uniform
     glActiveTexture(GL_TEXTURE0);
-    location = m_shader->getUniformLocation("ReflectionTexture");
-    glUniform1i(location, 0);   // texture unit 0
+    m_shader->set(Uniform::ReflectionTexture, 0);        // texture unit 0
     
     //      3) The refraction texture uniform
     glActiveTexture(GL_TEXTURE1);
-    location = m_shader->getUniformLocation("RefractionTexture");
-    glUniform1i(location, 1);   // texture unit 1
+    m_shader->set(Uniform::RefractionTexture, 1);        // texture unit 1
     
     //      4) The refraction depth texture uniform
     glActiveTexture(GL_TEXTURE2);
-    location = m_shader->getUniformLocation("RefractionDepthTexture");
-    glUniform1i(location, 2);   // texture unit 2
+    m_shader->set(Uniform::RefractionDepthTexture, 2);   // texture unit 2
     
     //      5) The du/dv map texture uniform
     glActiveTexture(GL_TEXTURE3);
-    location = m_shader->getUniformLocation("wavemap.DisplacementMap");
-    glUniform1i(location, 3);   // texture unit 3
+    m_shader->set(Uniform::DisplacementMap, 3);          // texture unit 3
     
     //      6) The normal map texture uniform
     glActiveTexture(GL_TEXTURE4);
-    location = m_shader->getUniformLocation("wavemap.BumpMap");
-    glUniform1i(location, 4);   // texture unit 4
+    m_shader->set(Uniform::BumpMap, 4);                  // texture unit 4
     
     //      7) The projection matrix near/far values
-    location = m_shader->getUniformLocation("Near");
-    glUniform1f(location, m_scene->camera()->near());
-    location = m_shader->getUniformLocation("Far");
-    glUniform1f(location, m_scene->camera()->far());
+    m_shader->set(Uniform::Near, m_scene->camera()->near());
+    m_shader->set(Uniform::Far, m_scene->camera()->far());
     
-    uploadMaterialUniforms(vec3(0.0, 0.0, 0.0), // kd
-                           vec3(0.6, 0.6, 0.6), // ks
-                           20);                 // shininess
+    setMaterial(vec3(0.0, 0.0, 0.0), // kd
+                vec3(0.6, 0.6, 0.6), // ks
+                20);                 // shininess
     
     m_shader->disable();
     glBindVertexArray(0);
     releaseData();
 }
 
-void Water::uploadLightingUniforms()
-{
-    GLint location = m_shader->getUniformLocation("LightColor");
-    glUniform3fv( location, 1, value_ptr(m_scene->sun()->color()) );
-    
-    location = m_shader->getUniformLocation("LightPosition");
-    glUniform3fv( location, 1, value_ptr(m_scene->sun()->position()) );
-    
-    location = m_shader->getUniformLocation("CameraPosition");
-    glUniform3fv(location, 1, value_ptr(m_scene->camera()->position()));
-    
-    // No ambient intensity
-    
-    CHECK_GL_ERRORS;
-}
-
-void Water::uploadClippingUniforms(Mode m)
-{
-    // water shader doesn't take clipping uniforms
-}
-
 static float TIME = 0.0f; // slowly goes from 0->1 repeatedly
 void Water::uploadCustomUniforms(Mode m)
 {
     // Pass the "Time" value
-    GLint location = m_shader->getUniformLocation("Time");
-    glUniform1f(location, TIME);
+    m_shader->set(Uniform::Time, TIME);
     TIME += 0.001f;
     if (TIME > 1.0f) TIME -= 1.0f;
     
-    location = m_shader->getUniformLocation("WaterDistortion");
-    glUniform1f(location, m_distortion);
-    
-    location = m_shader->getUniformLocation("BumpMapping");
-    glUniform1i(location, m_bumpMapping);
-    
-    location = m_shader->getUniformLocation("Mode");
-    glUniform1i(location, (int) m_renderingMode);
-    
-    CHECK_GL_ERRORS;
-}
-
-void Water::bindData()
-{
-    glBindBuffer( GL_ARRAY_BUFFER, m_vbo );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, m_ebo );
-    
-    // We need to upload the reflection & refraction textures stored in their respective FBOs
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_scene->reflectionTexture());
-    
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, m_scene->refractionTexture());
-    
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, m_scene->refractionDepthTexture());
-    
-    // Bind the normal & du/dv maps regularly
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, m_textureIDs[0]);
-    
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, m_textureIDs[1]);
+    m_shader->set(Uniform::WaterDistortion, m_distortion);
+    m_shader->set(Uniform::BumpMapping, m_bumpMapping);
+    m_shader->set(Uniform::WaterMode, (int) m_renderingMode);
     
     CHECK_GL_ERRORS;
 }
 
-void Water::drawElements()
+void Water::describeDraw(DrawPacket& packet)
 {
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+    // We need the reflection & refraction textures stored in their respective FBOs
+    packet.addTexture(GL_TEXTURE_2D, m_scene->reflectionTexture());       // texture unit 0
+    packet.addTexture(GL_TEXTURE_2D, m_scene->refractionTexture());       // texture unit 1
+    packet.addTexture(GL_TEXTURE_2D, m_scene->refractionDepthTexture());  // texture unit 2
     
-    CHECK_GL_ERRORS;
-}
-
-void Water::releaseData()
-{
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // Followed by the du/dv & normal maps
+    packet.addTexture(GL_TEXTURE_2D, m_textureIDs[0]);                    // texture unit 3
+    packet.addTexture(GL_TEXTURE_2D, m_textureIDs[1]);                    // texture unit 4
     
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    
-    glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    packet.primitive = GL_TRIANGLES;
+    packet.count = 6;
+    packet.indexType = GL_UNSIGNED_SHORT;
     
-    glBindBuffer( GL_ARRAY_BUFFER, 0 );
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
-    
-    CHECK_GL_ERRORS;
+    // Drawn after the opaque objects so that it can blend with them
+    packet.layer = LAYER_WATER;
 }
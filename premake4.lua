@@ -72,3 +72,45 @@ solution "CS488-Projects"
     configuration "Release"
         defines { "NDEBUG" }
         flags { "Optimize" }
+
+    -- Cooks every asset ahead of time & times loading them (see Tools/AssetCooker.cpp)
+    project "AssetCooker"
+        kind "ConsoleApp"
+        language "C++"
+        location "build"
+        objdir "build/AssetCooker"
+        targetdir "."
+        buildoptions (buildOptions)
+        libdirs (libDirectories)
+        links { "lodepng", "Assimp", "pthread" }
+        includedirs (includeDirList)
+        files { "Tools/AssetCooker.cpp", "CookedFile.cpp", "CookedModel.cpp", "CookedTexture.cpp", "FileSystem.cpp", "MeshOptimizer.cpp" }
+
+    configuration "Debug"
+        defines { "DEBUG" }
+        flags { "Symbols" }
+
+    configuration "Release"
+        defines { "NDEBUG" }
+        flags { "Optimize" }
+
+    -- Packs the Assets folder into Assets.pack (see Tools/AssetPacker.cpp)
+    project "AssetPacker"
+        kind "ConsoleApp"
+        language "C++"
+        location "build"
+        objdir "build/AssetPacker"
+        targetdir "."
+        buildoptions (buildOptions)
+        libdirs (libDirectories)
+        links { "lodepng" }
+        includedirs (includeDirList)
+        files { "Tools/AssetPacker.cpp", "CookedFile.cpp", "FileSystem.cpp" }
+
+    configuration "Debug"
+        defines { "DEBUG" }
+        flags { "Symbols" }
+
+    configuration "Release"
+        defines { "NDEBUG" }
+        flags { "Optimize" }